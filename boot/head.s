@@ -12,7 +12,7 @@
  * the page directory.
  */
 .text
-.globl _idt,_gdt,_pg_dir,_tmp_floppy_area,startup_32
+.globl _idt,_gdt,_pg_dir,_tmp_floppy_area,_empty_zero_page,startup_32
 _pg_dir:
 startup_32:
 	movl $0x10,%eax
@@ -108,8 +108,8 @@ setup_gdt:
 
 /*
  * I put the kernel page tables right after the page directory,
- * using 4 of them to span 16 Mb of physical memory. People with
- * more than 16MB will have to expand this.
+ * using 4 of them to span 16 Mb of physical memory. mem_init()
+ * builds the page tables for any memory above that.
  */
 .org 0x1000
 pg0:
@@ -124,6 +124,15 @@ pg2:
 pg3:
 
 .org 0x5000
+/*
+ * empty_zero_page is mapped read-only for reads of untouched anonymous
+ * memory (bss, brk, stack). It's below LOW_MEM, so mm never counts or
+ * frees it. Nobody must ever write to it.
+ */
+_empty_zero_page:
+	.fill 4096,1,0
+
+.org 0x6000
 /*
  * tmp_floppy_area is used by the floppy-driver when DMA cannot
  * reach to a buffer-block. It needs to be aligned, so that it isn't
@@ -185,14 +194,10 @@ ignore_int:
  * will be mapped to some other place - mm keeps track of
  * that.
  *
- * For those with more memory than 16 Mb - tough luck. I've
- * not got it, why should you :-) The source is here. Change
- * it. (Seriously - it shouldn't be too difficult. Mostly
- * change some constants etc. I left it at 16Mb, as my machine
- * even cannot be extended past that (ok, but it was cheap :-)
- * I've tried to show which constants to change by having
- * some kind of marker at them (search for "16Mb"), but I
- * won't guarantee that's all :-( )
+ * Memory above 16 Mb gets its page tables in mem_init(), once
+ * we know how much there is. The kernel segments cover the
+ * first 1Gb of linear space, where all physical memory is
+ * mapped in every page directory.
  */
 .align 4
 setup_paging:
@@ -225,14 +230,14 @@ idt_descr:
 .align 4
 .word 0
 gdt_descr:
-	.word 256*8-1		# so does gdt (not that that's any
-	.long _gdt		# magic number, but it works for me :^)
+	.word 1024*8-1		# gdt has 1024 entries, room for the
+	.long _gdt		# TSS's and LDT's of 256 tasks
 
 	.align 8
 _idt:	.fill 256,8,0		# idt is uninitialized
 
 _gdt:	.quad 0x0000000000000000	/* NULL descriptor */
-	.quad 0x00c09a0000000fff	/* 16Mb */
-	.quad 0x00c0920000000fff	/* 16Mb */
+	.quad 0x00c39a000000ffff	/* 1Gb */
+	.quad 0x00c392000000ffff	/* 1Gb */
 	.quad 0x0000000000000000	/* TEMPORARY - don't use */
-	.fill 252,8,0			/* space for LDT's and TSS's etc */
+	.fill 1020,8,0			/* space for LDT's and TSS's etc */
@@ -114,7 +114,7 @@ void free_inode(struct m_inode *inode)
 	if (!inode)
 		return;
 	if (!inode->i_dev) {
-		memset(inode, 0, sizeof(*inode));
+		clear_inode(inode);
 		return;
 	}
 	if (inode->i_count > 1) {
@@ -132,7 +132,7 @@ void free_inode(struct m_inode *inode)
 	if (clear_bit(inode->i_num & 8191, bh->b_data))
 		printk("free_inode: bit already cleared.\n\r");
 	bh->b_dirt = 1;
-	memset(inode, 0, sizeof(*inode));
+	clear_inode(inode);
 }
 
 struct m_inode *new_inode(int dev)
@@ -30,7 +30,7 @@ extern int end;
 struct buffer_head *start_buffer = (struct buffer_head *)&end;
 struct buffer_head *hash_table[NR_HASH];
 static struct buffer_head *free_list;
-static struct task_struct *buffer_wait = NULL;
+static struct wait_queue *buffer_wait = NULL;
 int NR_BUFFERS = 0;
 
 static inline void wait_on_buffer(struct buffer_head *bh)
@@ -206,10 +206,15 @@ struct buffer_head *get_hash_table(int dev, int block)
 struct buffer_head *getblk(int dev, int block)
 {
 	struct buffer_head *tmp, *bh;
+	int slept = 0;
 
 repeat:
-	if (bh = get_hash_table(dev, block))
+	if (bh = get_hash_table(dev, block)) {
+/* we may have eaten the brelse() wakeup meant for someone who needs a buffer */
+		if (slept)
+			wake_up(&buffer_wait);
 		return bh;
+	}
 	tmp = free_list;
 	do {
 		if (tmp->b_count)
@@ -222,7 +227,8 @@ repeat:
 /* and repeat until we find something good */
 	} while ((tmp = tmp->b_next_free) != free_list);
 	if (!bh) {
-		sleep_on(&buffer_wait);
+		sleep_on_exclusive(&buffer_wait);
+		slept = 1;
 		goto repeat;
 	}
 	wait_on_buffer(bh);
@@ -15,6 +15,7 @@
 
 extern int tty_read(unsigned minor, char *buf, int count);
 extern int tty_write(unsigned minor, char *buf, int count);
+extern void write_verify(unsigned long address);
 
 typedef (*crw_ptr) (int rw, unsigned minor, char *buf, int count, off_t * pos);
 
@@ -36,6 +37,19 @@ static int rw_ram(int rw, char *buf, int count, off_t * pos)
 	return -EIO;
 }
 
+/*
+ * Before writing to a write-protected page, write_verify() gives us a
+ * private copy of it and of its page table (which may be shared after a
+ * fork()). Both may have moved, so look the entry up again.
+ */
+static unsigned long mem_make_writable(unsigned long pde, unsigned long addr)
+{
+	write_verify(addr);
+	if (!(1 & *(unsigned long *)pde))
+		return 0;
+	return (0xfffff000 & *(unsigned long *)pde) + (addr >> 10 & 0xffc);
+}
+
 static int rw_mem(int rw, char *buf, int count, off_t * pos)
 {
 	char *p;
@@ -47,15 +61,19 @@ static int rw_mem(int rw, char *buf, int count, off_t * pos)
 	/*
 	 * return EOF on nonexistant pages or pages swapped out to disk.
 	 */
-	pde = (unsigned long)pg_dir + (*pos >> 20 & 0xffc);
+	pde = (unsigned long)PAGE_DIR_OFFSET(current, *pos);
 	if (((pte = *((unsigned long *)pde)) & 1) == 0)
 		return 0;	/* page table not present */
 	pte &= 0xfffff000;
 	pte += *pos >> 10 & 0xffc;
 	if (((tmp = *((unsigned long *)pte)) & 1) == 0)
 		return 0;
-	if (rw == WRITE && (tmp & 2) == 0)
-		un_wp_page((unsigned long *)pte);
+	if (rw == WRITE && (tmp & 2) == 0) {
+		if (!(pte = mem_make_writable(pde, *pos)))
+			return 0;
+		if (((tmp = *((unsigned long *)pte)) & 1) == 0)
+			return 0;
+	}
 	p = (char *)((tmp & 0xfffff000) + (*pos & 0xfff));
 	while (1) {
 		if (rw == WRITE)
@@ -77,8 +95,13 @@ static int rw_mem(int rw, char *buf, int count, off_t * pos)
 			if (((tmp = *((unsigned long *)pte)) & 1) == 0)
 				break;
 
-			if (rw == WRITE && (tmp & 2) == 0)
-				un_wp_page((unsigned long *)pte);
+			if (rw == WRITE && (tmp & 2) == 0) {
+				pte = mem_make_writable(pde, *pos + count - i);
+				if (!pte)
+					break;
+				if (((tmp = *((unsigned long *)pte)) & 1) == 0)
+					break;
+			}
 			p = (char *)(tmp & 0xfffff000);
 		}
 	}
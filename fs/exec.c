@@ -46,18 +46,19 @@ int sys_uselib(const char *library)
 
 	if (get_limit(0x17) != TASK_SIZE)
 		return -EINVAL;
+	if (current->flags & PF_VFORK)	/* that's our parent's library */
+		return -EINVAL;
 	if (library) {
 		if (!(inode = namei(library)))	/* get library inode */
 			return -ENOENT;
 	} else
 		inode = NULL;
 /* we should check filetypes (headers etc), but we don't */
-	iput(current->library);
-	current->library = NULL;
+	set_library(current, NULL);
 	base = get_base(current->ldt[2]);
 	base += LIBRARY_OFFSET;
 	free_page_tables(base, LIBRARY_SIZE);
-	current->library = inode;
+	set_library(current, inode);
 	return 0;
 }
 
@@ -223,6 +224,7 @@ int do_execve(unsigned long *eip, long tmp, char *filename,
 	int retval;
 	int sh_bang = 0;
 	unsigned long p = PAGE_SIZE * MAX_ARG_PAGES - 4;
+	unsigned long new_dir = 0;
 	int ch;
 
 	if ((0xffff & eip[1]) != 0x000f)
@@ -347,6 +349,11 @@ restart_interp:
 			goto exec_error2;
 		}
 	}
+/* a vfork()ed child needs a page directory of its own */
+	if ((current->flags & PF_VFORK) && !(new_dir = new_page_dir())) {
+		retval = -ENOMEM;
+		goto exec_error2;
+	}
 /* OK, This is the point of no return */
 /* note that current->library stays unchanged by an exec */
 	for (i = 0; (ch = get_fs_byte(filename++)) != '\0';)
@@ -357,9 +364,7 @@ restart_interp:
 	if (i < 8)
 		current->comm[i] = '\0';
 
-	if (current->executable)
-		iput(current->executable);
-	current->executable = inode;
+	set_executable(current, inode);
 	current->signal = 0;
 	for (i = 0; i < 32; i++) {
 		current->sigaction[i].sa_mask = 0;
@@ -371,8 +376,13 @@ restart_interp:
 		if ((current->close_on_exec >> i) & 1)
 			sys_close(i);
 	current->close_on_exec = 0;
-	free_page_tables(get_base(current->ldt[1]), get_limit(0x0f));
-	free_page_tables(get_base(current->ldt[2]), get_limit(0x17));
+	if (current->flags & PF_VFORK)
+		vfork_release(current, new_dir);
+	else {
+		exit_mmap();
+		free_page_tables(get_base(current->ldt[1]), get_limit(0x0f));
+		free_page_tables(get_base(current->ldt[2]), get_limit(0x17));
+	}
 	if (last_task_used_math == current)
 		last_task_used_math = NULL;
 	current->used_math = 0;
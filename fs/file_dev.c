@@ -6,9 +6,11 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 
 #include <linux/sched.h>
 #include <linux/kernel.h>
+#include <linux/mm.h>
 #include <asm/segment.h>
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
@@ -18,10 +20,23 @@ int file_read(struct m_inode *inode, struct file *filp, char *buf, int count)
 {
 	int left, chars, nr;
 	struct buffer_head *bh;
+	unsigned long page;
 
 	if ((left = count) <= 0)
 		return 0;
 	while (left) {
+/* a shared mapping may have changed the page: it is what the file holds */
+		if ((page = find_page(inode, filp->f_pos & 0xfffff000)) != 0 &&
+		    get_page_ref(page)) {
+			nr = filp->f_pos & 0xfff;
+			chars = MIN(PAGE_SIZE - nr, left);
+			filp->f_pos += chars;
+			left -= chars;
+			while (chars-- > 0)
+				put_fs_byte(((char *)page)[nr++], buf++);
+			free_page(page);
+			continue;
+		}
 		if (nr = bmap(inode, (filp->f_pos) / BLOCK_SIZE)) {
 			if (!(bh = bread(inode->i_dev, nr)))
 				break;
@@ -48,10 +63,11 @@ int file_read(struct m_inode *inode, struct file *filp, char *buf, int count)
 int file_write(struct m_inode *inode, struct file *filp, char *buf, int count)
 {
 	off_t pos;
-	int block, c;
+	int block, c, n;
 	struct buffer_head *bh;
 	char *p;
 	int i = 0;
+	unsigned long page;
 
 /*
  * ok, append may not work when many processes are writing at the same time
@@ -78,8 +94,12 @@ int file_write(struct m_inode *inode, struct file *filp, char *buf, int count)
 			inode->i_dirt = 1;
 		}
 		i += c;
+		n = c;
 		while (c-- > 0)
 			*(p++) = get_fs_byte(buf++);
+/* keep the page cache (and so any shared mappings) up to date */
+		if ((page = find_page(inode, (pos - n) & 0xfffff000)) != 0)
+			memcpy((char *)page + ((pos - n) & 0xfff), p - n, n);
 		brelse(bh);
 	}
 	inode->i_mtime = CURRENT_TIME;
@@ -5,5 +5,47 @@
  */
 
 #include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
 
-struct file file_table[NR_FILE];
+/*
+ * File structures come from an object cache, so there's no system-wide
+ * limit on open files any more, only NR_OPEN per task. A file goes back
+ * to the cache when its last user closes it.
+ */
+static struct kmem_cache *file_cache;
+
+static void file_ctor(void *obj)
+{
+	struct file *f = (struct file *) obj;
+
+	f->f_count = 0;
+	f->f_inode = NULL;
+}
+
+/*
+ * Returns a file with f_count 1, or NULL if there's no memory.
+ */
+struct file *get_empty_filp(void)
+{
+	struct file *f;
+
+	if (!(f = (struct file *) kmem_cache_alloc(file_cache)))
+		return NULL;
+	f->f_count = 1;
+	return f;
+}
+
+void put_filp(struct file *f)
+{
+	file_ctor(f);
+	kmem_cache_free(file_cache, f);
+}
+
+void file_table_init(void)
+{
+	file_cache = kmem_cache_create("file", sizeof(struct file),
+				       file_ctor, 0);
+	if (!file_cache)
+		panic("Unable to get the file cache");
+}
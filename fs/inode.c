@@ -10,11 +10,21 @@
 #include <linux/sched.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
+#include <linux/slab.h>
 #include <asm/system.h>
 
 extern int *blk_size[];
 
-struct m_inode inode_table[NR_INODE] = { {0,}, };
+/*
+ * In-memory inodes come from an object cache, and all of them are on the
+ * list at first_inode. We keep NR_INODE around as a cache, and only add
+ * more when all of those are in use. They are never given back, so an
+ * inode pointer stays good across a sleep, and so does a walk of the
+ * list (new inodes go in at the head).
+ */
+static struct kmem_cache *inode_cache;
+struct m_inode *first_inode = NULL;
+int nr_inodes = 0;
 
 static void read_inode(struct m_inode *inode);
 static void write_inode(struct m_inode *inode);
@@ -42,13 +52,44 @@ static inline void unlock_inode(struct m_inode *inode)
 	wake_up(&inode->i_wait);
 }
 
+void clear_inode(struct m_inode *inode)
+{
+	struct m_inode *next = inode->i_next;
+
+	memset(inode, 0, sizeof(*inode));
+	inode->i_next = next;
+}
+
+static void inode_ctor(void *obj)
+{
+	memset(obj, 0, sizeof(struct m_inode));
+}
+
+static struct m_inode *grow_inodes(void)
+{
+	struct m_inode *inode;
+
+	if (!(inode = (struct m_inode *) kmem_cache_alloc(inode_cache)))
+		return NULL;
+	inode->i_next = first_inode;
+	first_inode = inode;
+	nr_inodes++;
+	return inode;
+}
+
+void inode_init(void)
+{
+	inode_cache = kmem_cache_create("inode", sizeof(struct m_inode),
+					inode_ctor, 0);
+	if (!inode_cache)
+		panic("Unable to get the inode cache");
+}
+
 void invalidate_inodes(int dev)
 {
-	int i;
 	struct m_inode *inode;
 
-	inode = 0 + inode_table;
-	for (i = 0; i < NR_INODE; i++, inode++) {
+	for (inode = first_inode; inode; inode = inode->i_next) {
 		wait_on_inode(inode);
 		if (inode->i_dev == dev) {
 			if (inode->i_count)
@@ -60,11 +101,9 @@ void invalidate_inodes(int dev)
 
 void sync_inodes(void)
 {
-	int i;
 	struct m_inode *inode;
 
-	inode = 0 + inode_table;
-	for (i = 0; i < NR_INODE; i++, inode++) {
+	for (inode = first_inode; inode; inode = inode->i_next) {
 		wait_on_inode(inode);
 		if (inode->i_dirt && !inode->i_pipe)
 			write_inode(inode);
@@ -180,6 +219,8 @@ repeat:
 		inode->i_count--;
 		return;
 	}
+	if (invalidate_inode_pages(inode, inode->i_nlinks))
+		goto repeat;	/* we slept writing pages back */
 	if (!inode->i_nlinks) {
 		truncate(inode);
 		free_inode(inode);
@@ -197,25 +238,28 @@ repeat:
 struct m_inode *get_empty_inode(void)
 {
 	struct m_inode *inode;
-	static struct m_inode *last_inode = inode_table;
+	static struct m_inode *last_inode = NULL;
 	int i;
 
 	do {
 		inode = NULL;
-		for (i = NR_INODE; i; i--) {
-			if (++last_inode >= inode_table + NR_INODE)
-				last_inode = inode_table;
-			if (!last_inode->i_count) {
-				inode = last_inode;
-				if (!inode->i_dirt && !inode->i_lock)
-					break;
+		if (nr_inodes >= NR_INODE)
+			for (i = nr_inodes; i; i--) {
+				if (!last_inode ||
+				    !(last_inode = last_inode->i_next))
+					last_inode = first_inode;
+				if (!last_inode->i_count) {
+					inode = last_inode;
+					if (!inode->i_dirt && !inode->i_lock)
+						break;
+				}
 			}
-		}
 		if (!inode) {
-			for (i = 0; i < NR_INODE; i++)
-				printk("%04x: %6d\t", inode_table[i].i_dev,
-				       inode_table[i].i_num);
-			panic("No free inodes in mem");
+			if (!(inode = grow_inodes())) {
+				printk("No free inodes in mem\n\r");
+				return NULL;
+			}
+			break;
 		}
 		wait_on_inode(inode);
 		while (inode->i_dirt) {
@@ -223,7 +267,7 @@ struct m_inode *get_empty_inode(void)
 			wait_on_inode(inode);
 		}
 	} while (inode->i_count);
-	memset(inode, 0, sizeof(*inode));
+	clear_inode(inode);
 	inode->i_count = 1;
 	return inode;
 }
@@ -251,15 +295,15 @@ struct m_inode *iget(int dev, int nr)
 	if (!dev)
 		panic("iget with dev==0");
 	empty = get_empty_inode();
-	inode = inode_table;
-	while (inode < NR_INODE + inode_table) {
+	inode = first_inode;
+	while (inode) {
 		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode++;
+			inode = inode->i_next;
 			continue;
 		}
 		wait_on_inode(inode);
 		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode = inode_table;
+			inode = first_inode;
 			continue;
 		}
 		inode->i_count++;
@@ -278,7 +322,7 @@ struct m_inode *iget(int dev, int nr)
 			iput(inode);
 			dev = super_block[i].s_dev;
 			nr = ROOT_INO;
-			inode = inode_table;
+			inode = first_inode;
 			continue;
 		}
 		if (empty)
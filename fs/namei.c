@@ -1037,7 +1037,7 @@ end_rename:
  */
 int sys_rename(const char *oldname, const char *newname)
 {
-	static struct task_struct *wait = NULL;
+	static struct wait_queue *wait = NULL;
 	static int lock = 0;
 	int result;
 
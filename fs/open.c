@@ -178,16 +178,12 @@ int sys_open(const char *filename, int flag, int mode)
 	if (fd >= NR_OPEN)
 		return -EINVAL;
 	current->close_on_exec &= ~(1 << fd);
-	f = 0 + file_table;
-	for (i = 0; i < NR_FILE; i++, f++)
-		if (!f->f_count)
-			break;
-	if (i >= NR_FILE)
-		return -EINVAL;
-	(current->filp[fd] = f)->f_count++;
+	if (!(f = get_empty_filp()))
+		return -ENFILE;
+	current->filp[fd] = f;
 	if ((i = open_namei(filename, flag, mode, &inode)) < 0) {
 		current->filp[fd] = NULL;
-		f->f_count = 0;
+		put_filp(f);
 		return i;
 	}
 /* ttys are somewhat special (ttyxx major==4, tty major==5) */
@@ -195,7 +191,7 @@ int sys_open(const char *filename, int flag, int mode)
 		if (check_char_dev(inode, inode->i_zone[0], flag)) {
 			iput(inode);
 			current->filp[fd] = NULL;
-			f->f_count = 0;
+			put_filp(f);
 			return -EAGAIN;
 		}
 /* Likewise with block-devices: check for floppy_change */
@@ -229,5 +225,6 @@ int sys_close(unsigned int fd)
 	if (--filp->f_count)
 		return (0);
 	iput(filp->f_inode);
+	put_filp(filp);
 	return (0);
 }
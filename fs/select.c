@@ -32,11 +32,15 @@
  * have to have interrupts disabled throughout the select, but that's not really
  * such a loss: sleeping automatically frees interrupts when we aren't in this
  * task.
+ *
+ * Each entry puts us on one wait queue for as long as the select sleeps,
+ * so the wait_entry has to live in the select_table, not on the stack of
+ * add_wait().
  */
 
 typedef struct {
-	struct task_struct *old_task;
-	struct task_struct **wait_address;
+	struct wait_queue wait;
+	struct wait_queue **wait_address;
 } wait_entry;
 
 typedef struct {
@@ -44,8 +48,9 @@ typedef struct {
 	wait_entry entry[NR_OPEN * 3];
 } select_table;
 
-static void add_wait(struct task_struct **wait_address, select_table * p)
+static void add_wait(struct wait_queue **wait_address, select_table * p)
 {
+	wait_entry *entry;
 	int i;
 
 	if (!wait_address)
@@ -53,29 +58,20 @@ static void add_wait(struct task_struct **wait_address, select_table * p)
 	for (i = 0; i < p->nr; i++)
 		if (p->entry[i].wait_address == wait_address)
 			return;
-	p->entry[p->nr].wait_address = wait_address;
-	p->entry[p->nr].old_task = *wait_address;
-	*wait_address = current;
+	entry = p->entry + p->nr;
+	entry->wait_address = wait_address;
+	entry->wait.task = current;
+	entry->wait.flags = 0;
+	add_wait_queue(wait_address, &entry->wait);
 	p->nr++;
 }
 
 static void free_wait(select_table * p)
 {
 	int i;
-	struct task_struct **tpp;
 
-	for (i = 0; i < p->nr; i++) {
-		tpp = p->entry[i].wait_address;
-		while (*tpp && *tpp != current) {
-			(*tpp)->state = 0;
-			current->state = TASK_UNINTERRUPTIBLE;
-			schedule();
-		}
-		if (!*tpp)
-			printk("free_wait: NULL");
-		if (*tpp = p->entry[i].old_task)
-			(**tpp).state = 0;
-	}
+	for (i = 0; i < p->nr; i++)
+		remove_wait_queue(p->entry[i].wait_address, &p->entry[i].wait);
 	p->nr = 0;
 }
 
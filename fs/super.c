@@ -182,7 +182,7 @@ int sys_umount(char *dev_name)
 		return -ENOENT;
 	if (!sb->s_imount->i_mount)
 		printk("Mounted inode has i_mount=0\n");
-	for (inode = inode_table + 0; inode < inode_table + NR_INODE; inode++)
+	for (inode = first_inode; inode; inode = inode->i_next)
 		if (inode->i_dev == dev && inode->i_count)
 			return -EBUSY;
 	sb->s_imount->i_mount = 0;
@@ -245,8 +245,6 @@ void mount_root(void)
 
 	if (32 != sizeof(struct d_inode))
 		panic("bad i-node size");
-	for (i = 0; i < NR_FILE; i++)
-		file_table[i].f_count = 0;
 	if (MAJOR(ROOT_DEV) == 2) {
 		printk("Insert root floppy and press ENTER");
 		wait_for_keypress();
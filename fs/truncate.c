@@ -70,6 +70,7 @@ void truncate(struct m_inode *inode)
 	if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) ||
 	      S_ISLNK(inode->i_mode)))
 		return;
+	invalidate_inode_pages(inode, 0);
 repeat:
 	block_busy = 0;
 	for (i = 0; i < 7; i++)
@@ -25,6 +25,14 @@
  * The keyboard is now defined in kernel/chr_dev/keyboard.S
  */
 
+/*
+ * When a page of an executable or library has to be read in, up to
+ * FAULT_AROUND pages around it (aligned) are mapped in as well if their
+ * blocks are already in the buffer cache. This is only the default:
+ * fault_around() (system call) changes it at run time. 1 turns it off.
+ */
+#define FAULT_AROUND 16
+
 /*
  * Normally, Linux can get the drive parameters from the BIOS at
  * startup, but if this for some unfathomable reason fails, you'd
@@ -7,6 +7,7 @@
 #define _FS_H
 
 #include <sys/types.h>
+#include <linux/wait.h>
 
 /* devices are as follows: (same as minix, so we can use the minix
  * file system. These are major numbers.)
@@ -41,8 +42,7 @@ void buffer_init(long buffer_end);
 #define SUPER_MAGIC 0x137F
 
 #define NR_OPEN 20
-#define NR_INODE 64
-#define NR_FILE 64
+#define NR_INODE 64		/* cached before unused ones are reused */
 #define NR_SUPER 8
 #define NR_HASH 307
 #define NR_BUFFERS nr_buffers
@@ -78,7 +78,7 @@ struct buffer_head {
 	unsigned char b_dirt;	/* 0-clean,1-dirty */
 	unsigned char b_count;	/* users using this block */
 	unsigned char b_lock;	/* 0 - ok, 1 -locked */
-	struct task_struct *b_wait;
+	struct wait_queue *b_wait;
 	struct buffer_head *b_prev;
 	struct buffer_head *b_next;
 	struct buffer_head *b_prev_free;
@@ -104,8 +104,10 @@ struct m_inode {
 	unsigned char i_nlinks;
 	unsigned short i_zone[9];
 /* these are in memory also */
-	struct task_struct *i_wait;
-	struct task_struct *i_wait2;	/* for pipes */
+	struct wait_queue *i_wait;
+	struct wait_queue *i_wait2;	/* for pipes */
+	struct task_struct *i_mapped[2];	/* tasks with this as their */
+					/* executable/library, see below */
 	unsigned long i_atime;
 	unsigned long i_ctime;
 	unsigned short i_dev;
@@ -117,8 +119,15 @@ struct m_inode {
 	unsigned char i_mount;
 	unsigned char i_seek;
 	unsigned char i_update;
+	struct m_inode *i_next;		/* all inodes in memory */
 };
 
+/*
+ * Indices into i_mapped[] and the matching task->map_next/map_prev links.
+ */
+#define I_MAP_EXEC	0
+#define I_MAP_LIB	1
+
 struct file {
 	unsigned short f_mode;
 	unsigned short f_flags;
@@ -143,7 +152,7 @@ struct super_block {
 	struct m_inode *s_isup;
 	struct m_inode *s_imount;
 	unsigned long s_time;
-	struct task_struct *s_wait;
+	struct wait_queue *s_wait;
 	unsigned char s_lock;
 	unsigned char s_rd_only;
 	unsigned char s_dirt;
@@ -165,8 +174,8 @@ struct dir_entry {
 	char name[NAME_LEN];
 };
 
-extern struct m_inode inode_table[NR_INODE];
-extern struct file file_table[NR_FILE];
+extern struct m_inode *first_inode;
+extern int nr_inodes;
 extern struct super_block super_block[NR_SUPER];
 extern struct buffer_head *start_buffer;
 extern int nr_buffers;
@@ -189,6 +198,11 @@ extern void iput(struct m_inode *inode);
 extern struct m_inode *iget(int dev, int nr);
 extern struct m_inode *get_empty_inode(void);
 extern struct m_inode *get_pipe_inode(void);
+extern void clear_inode(struct m_inode *inode);
+extern void inode_init(void);
+extern struct file *get_empty_filp(void);
+extern void put_filp(struct file *f);
+extern void file_table_init(void);
 extern struct buffer_head *get_hash_table(int dev, int block);
 extern struct buffer_head *getblk(int dev, int block);
 extern void ll_rw_block(int rw, struct buffer_head *bh);
@@ -6,7 +6,8 @@ typedef struct desc_struct {
 } desc_table[256];
 
 extern unsigned long pg_dir[1024];
-extern desc_table idt, gdt;
+extern desc_table idt;
+extern struct desc_struct gdt[1024];
 
 #define GDT_NUL 0
 #define GDT_CODE 1
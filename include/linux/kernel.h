@@ -10,13 +10,9 @@ void console_print(const char *str);
 int tty_write(unsigned ch, char *buf, int count);
 void *malloc(unsigned int size);
 void free_s(void *obj, int size);
-extern void hd_times_out(void);
-extern void sysbeepstop(void);
 extern void blank_screen(void);
 extern void unblank_screen(void);
 
-extern int beepcount;
-extern int hd_timeout;
 extern int blankinterval;
 extern int blankcount;
 
@@ -8,14 +8,53 @@
 
 extern int SWAP_DEV;
 
-#define read_swap_page(nr,buffer) ll_rw_page(READ,SWAP_DEV,(nr),(buffer));
-#define write_swap_page(nr,buffer) ll_rw_page(WRITE,SWAP_DEV,(nr),(buffer));
+/*
+ * A swap entry names a page on one of the swap areas: the area's index
+ * in swap_info[] and the page offset on that device.
+ */
+#define MAX_SWAPFILES 8
 
+#define SWP_TYPE(entry)		(((entry) >> 24) & 0x3f)
+#define SWP_OFFSET(entry)	((entry) & 0xffffff)
+#define SWP_ENTRY(type,offset)	(((type) << 24) | (offset))
+
+extern void rw_swap_page(int rw, int entry, char *buffer);
+
+#define read_swap_page(nr,buffer) rw_swap_page(READ,(nr),(buffer))
+#define write_swap_page(nr,buffer) rw_swap_page(WRITE,(nr),(buffer))
+
+/*
+ * The buddy allocator hands out blocks of up to 2^(NR_MEM_LISTS-1)
+ * physically contiguous pages.
+ */
+#define NR_MEM_LISTS 6
+
+extern unsigned long __get_free_pages(int order);
+extern unsigned long get_free_pages(int order);
 extern unsigned long get_free_page(void);
 extern unsigned long put_dirty_page(unsigned long page, unsigned long address);
+extern void free_pages(unsigned long addr, int order);
 extern void free_page(unsigned long addr);
+extern void free_area_init(unsigned long start_mem, unsigned long end_mem);
+extern void show_free_areas(void);
+extern int refill_zero_pool(void);
+extern int swap_out(void);
 void swap_free(int page_nr);
+int swap_duplicate(int page_nr);
 void swap_in(unsigned long *table_ptr);
+void read_swap_entry(int swap_nr, char *buffer);
+
+/*
+ * Swap entries with SWP_ZSWAP set are in the compressed pool (zswap.c),
+ * not on a swap device.
+ */
+#define SWP_ZSWAP	0x40000000
+
+extern int zswap_store(unsigned long page);
+extern void zswap_load(int nr, char *buffer);
+extern int zswap_duplicate(int nr);
+extern void zswap_free(int nr);
+extern void show_zswap(void);
 
 extern inline volatile void oom(void)
 {
@@ -24,17 +63,104 @@ extern inline volatile void oom(void)
 }
 
 #define invalidate() \
-__asm__("movl %%eax,%%cr3"::"a" (0))
+__asm__("movl %%cr3,%%eax\n\tmovl %%eax,%%cr3":::"ax")
+
+/*
+ * invalidate_page() flushes the TLB entry for one linear address. Only
+ * the 486 and up have 'invlpg': a 386 has to flush the lot. Use it only
+ * for the current task's own mappings: switch_to reloads cr3, so no
+ * other task's entries are ever in the TLB.
+ */
+extern int has_invlpg;
+
+#define invalidate_page(addr) \
+do { \
+	if (has_invlpg) \
+		__asm__ __volatile__("invlpg %0"::"m" (*(char *) (addr))); \
+	else \
+		invalidate(); \
+} while (0)
+
+struct task_struct;
+extern void flush_task_page(unsigned long *table_entry, struct task_struct *p,
+			    unsigned long address);
+extern void un_wp_page(unsigned long *table_entry, unsigned long address);
 
 /* these are not to be changed without changing head.s etc */
 #define LOW_MEM 0x100000
 extern unsigned long HIGH_MEMORY;
-#define PAGING_MEMORY (15*1024*1024)
-#define PAGING_PAGES (PAGING_MEMORY>>12)
 #define MAP_NR(addr) (((addr)-LOW_MEM)>>12)
-#define USED 100
 
-extern unsigned char mem_map[PAGING_PAGES];
+/*
+ * mem_map[] has one page descriptor per page from LOW_MEM up to
+ * HIGH_MEMORY. 'count' is the number of references (page table entries,
+ * or the owner of a kernel page), 0 for free pages. Pages the kernel
+ * itself lives in are marked PG_reserved and never freed. 'private'
+ * belongs to whoever owns the page: kernel malloc() keeps the bucket
+ * descriptor of its pages there, the slab allocator the cache. Pages
+ * in the page cache (mm/filemap.c) have 'inode' set.
+ */
+struct m_inode;
+
+struct page {
+	unsigned short count;
+	unsigned short flags;
+	unsigned long private;
+	struct m_inode *inode;		/* page cache: the file, */
+	unsigned long offset;		/* where in it, */
+	struct page *next_hash;		/* and the hash chain */
+};
+
+#define MAX_PAGE_COUNT	0xffff
+
+#define PG_reserved	0x0001
+#define PG_locked	0x0002	/* these three are for the page cache */
+#define PG_dirty	0x0004	/* and reclaim */
+#define PG_referenced	0x0008
+#define PG_bucket	0x0010	/* a kernel malloc() bucket */
+#define PG_slab		0x0020	/* a slab of an object cache */
+
+extern int paging_pages;
+extern struct page *mem_map;
+
+/*
+ * Take another reference to the page at 'addr'. Returns 0 instead of
+ * letting the count wrap, in which case the caller mustn't share it.
+ */
+static inline int get_page_ref(unsigned long addr)
+{
+	struct page *page = mem_map + MAP_NR(addr);
+
+	if (page->count >= MAX_PAGE_COUNT)
+		return 0;
+	page->count++;
+	return 1;
+}
+
+extern int nr_cache_pages;
+extern unsigned long find_page(struct m_inode *inode, unsigned long offset);
+extern unsigned long get_cache_page(struct m_inode *inode,
+				    unsigned long offset);
+extern void write_page(struct m_inode *inode, unsigned long page,
+		       unsigned long offset);
+extern int invalidate_inode_pages(struct m_inode *inode, int sync);
+extern int shrink_page_cache(void);
+
+extern char empty_zero_page[PAGE_SIZE];
+#define ZERO_PAGE ((unsigned long) empty_zero_page)
+
+/*
+ * A vm_area_struct describes one mmap()ed range [vm_start, vm_end) of a
+ * task's user space, in segment (not linear) addresses. vm_inode is NULL
+ * for anonymous memory. The list in task->mmap is sorted by address.
+ */
+struct vm_area_struct {
+	unsigned long vm_start, vm_end;
+	unsigned short vm_prot, vm_flags;	/* PROT_xxx, MAP_xxx */
+	struct m_inode *vm_inode;
+	unsigned long vm_offset;		/* file offset of vm_start */
+	struct vm_area_struct *vm_next;
+};
 
 #define PAGE_DIRTY	0x40
 #define PAGE_ACCESSED	0x20
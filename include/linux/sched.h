@@ -3,8 +3,14 @@
 
 #define HZ 100
 
-#define NR_TASKS	64
-#define TASK_SIZE	0x04000000
+/*
+ * Every task has a page directory of its own. The first TASK_SIZE bytes
+ * of linear space map physical memory for the kernel, and are the same
+ * in all directories. User space is the next TASK_SIZE bytes: all user
+ * segments start at TASK_SIZE.
+ */
+#define NR_TASKS	256
+#define TASK_SIZE	0x40000000
 #define LIBRARY_SIZE	0x00400000
 
 #if (TASK_SIZE & 0x3fffff)
@@ -19,8 +25,21 @@
 #error "LIBRARY_SIZE too damn big!"
 #endif
 
-#if (((TASK_SIZE>>16)*NR_TASKS) != 0x10000)
-#error "TASK_SIZE*NR_TASKS must be 4GB"
+#if (TASK_SIZE > 0x80000000)
+#error "TASK_SIZE too big: kernel and user space must both fit in 4GB"
+#endif
+
+/*
+ * A page table is referenced at most once per task, so its count can't
+ * overflow. Data pages can (a task may mmap() one page over and over):
+ * get_page_ref() refuses those.
+ */
+#if (NR_TASKS >= 0xffff)
+#error "NR_TASKS too big for the mem_map page counts"
+#endif
+
+#if (4+2*NR_TASKS > 1024)
+#error "Not enough room in the gdt for all the TSS's and LDT's"
 #endif
 
 #define LIBRARY_OFFSET (TASK_SIZE - LIBRARY_SIZE)
@@ -47,6 +66,8 @@
 	load += n*(FIXED_1-exp); \
 	load >>= FSHIFT;
 
+extern unsigned long avenrun[3];
+
 #define CT_TO_SECS(x)	((x) / HZ)
 #define CT_TO_USECS(x)	(((x) % HZ) * 1000000/HZ)
 
@@ -56,6 +77,7 @@
 #include <linux/head.h>
 #include <linux/fs.h>
 #include <linux/mm.h>
+#include <linux/timer.h>
 #include <sys/param.h>
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -75,11 +97,25 @@
 #define NULL ((void *) 0)
 #endif
 
-extern int copy_page_tables(unsigned long from, unsigned long to, long size);
+extern int copy_page_tables(struct task_struct *tsk);
 extern int free_page_tables(unsigned long from, unsigned long size);
+extern unsigned long new_page_dir(void);
+extern void unmap_page_range(unsigned long from, unsigned long size);
+extern struct vm_area_struct *find_vma(struct task_struct *tsk,
+				       unsigned long addr);
+extern int dup_mmap(struct task_struct *p);
+extern void free_mmap(struct task_struct *p);
+extern void exit_mmap(void);
+extern void vfork_release(struct task_struct *p, unsigned long dir);
+extern void set_executable(struct task_struct *p, struct m_inode *inode);
+extern void set_library(struct task_struct *p, struct m_inode *inode);
+extern void count_fault(struct task_struct *p);
+extern int swap_out_task(struct task_struct *p, int dirty_ok);
 
 extern void sched_init(void);
 extern void schedule(void);
+extern void stop_tick(void);
+extern void start_tick(void);
 extern void trap_init(void);
 extern void panic(const char *str);
 extern int tty_write(unsigned minor, char *buf, int count);
@@ -143,17 +179,25 @@ struct task_struct {
 	 * p->p_pptr->pid)
 	 */
 	struct task_struct *p_pptr, *p_cptr, *p_ysptr, *p_osptr;
+	struct wait_queue *vfork_wait;	/* parent sleeps here during vfork */
+	struct task_struct *run_next;	/* run queue, see sched.c */
+	unsigned long sched_epoch;
 	unsigned short uid, euid, suid;
 	unsigned short gid, egid, sgid;
-	unsigned long timeout, alarm;
+	unsigned long timeout;
 	long utime, stime, cutime, cstime, start_time;
 	unsigned long min_flt, maj_flt;
 	unsigned long cmin_flt, cmaj_flt;
 	struct rlimit rlim[RLIM_NLIMITS];
 	unsigned int flags;	/* per process flags, defined below */
 	unsigned short used_math;
-	unsigned short rss;	/* number of resident pages */
+	unsigned long rss;	/* number of resident pages */
+	unsigned long swap_address;	/* where swap_out() goes on */
+	unsigned long flt_rate, flt_stamp;	/* recent faults, see swap.c */
 	char comm[8];
+/* mmap()ed areas */
+	struct vm_area_struct *mmap;
+	struct timer_list real_timer;	/* for alarm() */
 /* file system info */
 	int tty;		/* -1 if no tty, so it must be signed */
 	unsigned short umask;
@@ -161,6 +205,7 @@ struct task_struct {
 	struct m_inode *root;
 	struct m_inode *executable;
 	struct m_inode *library;
+	struct task_struct *map_next[2], *map_prev[2];	/* see i_mapped */
 	unsigned long close_on_exec;
 	struct file *filp[NR_OPEN];
 /* ldt for this task 0 - zero 1 - cs 2 - ds&ss */
@@ -174,6 +219,15 @@ struct task_struct {
  */
 #define PF_ALIGNWARN	0x00000001	/* Print alignment warning msgs */
 					/* Not implemented yet, only for 486 */
+#define PF_VFORK	0x00000002	/* Borrowing the parent's memory */
+
+/*
+ * Flags for copy_process(). CLONE_VM runs the child in the parent's
+ * address space, CLONE_VFORK keeps the parent asleep until the child
+ * has exec'ed or exited.
+ */
+#define CLONE_VM	0x00000100
+#define CLONE_VFORK	0x00004000
 
 /*
  *  INIT_TASK is used to set up the first task table, touch at
@@ -186,17 +240,21 @@ struct task_struct {
 /* pid etc.. */	0,0,0,0, \
 /* suppl grps*/ {NOGROUP,}, \
 /* proc links*/ &init_task.task,0,0,0, \
+/* vfork */	NULL, \
+/* runq */	NULL,0, \
 /* uid etc */	0,0,0,0,0,0, \
-/* timeout */	0,0,0,0,0,0,0, \
+/* timeout */	0,0,0,0,0,0, \
 /* min_flt */	0,0,0,0, \
 /* rlimits */   { {0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff},  \
 		  {0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}, \
 		  {0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}}, \
 /* flags */	0, \
 /* math */	0, \
-/* rss  */	2, \
+/* rss  */	2,0,0,0, \
 /* comm */	"init", \
-/* fs info */	-1,0022,NULL,NULL,NULL,NULL,0, \
+/* mmap */	NULL, \
+/* alarm */	{NULL,}, \
+/* fs info */	-1,0022,NULL,NULL,NULL,NULL,{NULL,},{NULL,},0, \
 /* filp */	{NULL,}, \
 	{ \
 		{0,0}, \
@@ -220,10 +278,16 @@ extern int jiffies_offset;
 
 #define CURRENT_TIME (startup_time+(jiffies+jiffies_offset)/HZ)
 
-extern void add_timer(long jiffies, void (*fn) (void));
-extern void sleep_on(struct task_struct **p);
-extern void interruptible_sleep_on(struct task_struct **p);
-extern void wake_up(struct task_struct **p);
+extern void add_wait_queue(struct wait_queue **p, struct wait_queue *wait);
+extern void remove_wait_queue(struct wait_queue **p, struct wait_queue *wait);
+extern void sleep_on(struct wait_queue **p);
+extern void sleep_on_exclusive(struct wait_queue **p);
+extern void interruptible_sleep_on(struct wait_queue **p);
+extern void wake_up(struct wait_queue **p);
+extern void wake_up_all(struct wait_queue **p);
+extern void wake_up_process(struct task_struct *p);
+extern void signal_wake_up(struct task_struct *p);
+extern int nr_running(void);
 extern int in_group_p(gid_t grp);
 
 /*
@@ -234,6 +298,7 @@ extern int in_group_p(gid_t grp);
 #define FIRST_LDT_ENTRY (FIRST_TSS_ENTRY+1)
 #define _TSS(n) ((((unsigned long) n)<<4)+(FIRST_TSS_ENTRY<<3))
 #define _LDT(n) ((((unsigned long) n)<<4)+(FIRST_LDT_ENTRY<<3))
+#define TASK_NR(p) (((p)->tss.ldt-(FIRST_LDT_ENTRY<<3))>>4)
 #define ltr(n) __asm__("ltr %%ax"::"a" (_TSS(n)))
 #define lldt(n) __asm__("lldt %%ax"::"a" (_LDT(n)))
 #define str(n) \
@@ -265,6 +330,10 @@ __asm__("cmpl %%ecx,_current\n\t" \
 
 #define PAGE_ALIGN(n) (((n)+0xfff)&0xfffff000)
 
+/* the page directory entry of 'address' in task 'tsk' */
+#define PAGE_DIR_OFFSET(tsk,address) \
+((unsigned long *) ((tsk)->tss.cr3 + (((address) >> 20) & 0xffc)))
+
 #define _set_base(addr,base) \
 __asm__("movw %%dx,%0\n\t" \
 	"rorl $16,%%edx\n\t" \
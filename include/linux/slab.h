@@ -0,0 +1,40 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+/*
+ * Object caches, see mm/slab.c.
+ */
+
+struct slab;
+
+struct kmem_cache {
+	const char *name;
+	int size;			/* object size, rounded to longs */
+	int num;			/* objects per slab */
+	int offset;			/* of the first object in the slab */
+	int flags;
+	int reserve;			/* objects we keep slabs for */
+	void (*ctor) (void *);
+	struct slab *partial;		/* slabs with free objects */
+	struct slab *full;
+/* statistics */
+	int nr_slabs;
+	int nr_active;
+	int high;			/* most objects ever in use */
+	unsigned long nr_allocs;
+	unsigned long nr_frees;
+	unsigned long nr_grows;
+	unsigned long nr_reaps;
+	struct kmem_cache *next;
+};
+
+#define SLAB_ATOMIC	0x0001	/* don't swap to get a page */
+
+extern struct kmem_cache *kmem_cache_create(const char *name, int size,
+					    void (*ctor) (void *), int flags);
+extern int kmem_cache_reserve(struct kmem_cache *cache, int nr);
+extern void *kmem_cache_alloc(struct kmem_cache *cache);
+extern void kmem_cache_free(struct kmem_cache *cache, void *obj);
+extern void show_slab(void);
+
+#endif
@@ -89,6 +89,13 @@ extern int sys_symlink();
 extern int sys_lstat();
 extern int sys_readlink();
 extern int sys_uselib();
+extern int sys_vfork();
+extern int sys_mmap();
+extern int sys_munmap();
+extern int sys_swapon();
+extern int sys_swapoff();
+extern int sys_sysinfo();
+extern int sys_fault_around();
 
 fn_ptr sys_call_table[] = { sys_setup, sys_exit, sys_fork, sys_read,
 	sys_write, sys_open, sys_close, sys_waitpid, sys_creat, sys_link,
@@ -106,7 +113,8 @@ fn_ptr sys_call_table[] = { sys_setup, sys_exit, sys_fork, sys_read,
 	    sys_sethostname,
 	sys_setrlimit, sys_getrlimit, sys_getrusage, sys_gettimeofday,
 	sys_settimeofday, sys_getgroups, sys_setgroups, sys_select, sys_symlink,
-	sys_lstat, sys_readlink, sys_uselib
+	sys_lstat, sys_readlink, sys_uselib, sys_vfork, sys_mmap,
+	sys_munmap, sys_swapon, sys_swapoff, sys_sysinfo, sys_fault_around
 };
 
 /* So we don't have to do any more manual updating.... */
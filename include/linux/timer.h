@@ -0,0 +1,28 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+/*
+ * Kernel timers, see kernel/timer.c. Fill in 'expires' (in jiffies),
+ * 'function' and 'data', and add_timer() it. The function is called
+ * from the timer interrupt, with interrupts off, once jiffies reaches
+ * 'expires'; the timer is no longer pending by then, so it may add
+ * itself again.
+ */
+struct timer_list {
+	struct timer_list *next;
+	struct timer_list **pprev;	/* NULL if not pending */
+	unsigned long expires;
+	unsigned long data;
+	void (*function) (unsigned long);
+};
+
+extern void init_timer(struct timer_list *timer);
+extern void add_timer(struct timer_list *timer);
+extern int del_timer(struct timer_list *timer);
+extern void mod_timer(struct timer_list *timer, unsigned long expires);
+extern void run_timers(void);
+extern unsigned long next_timer_interrupt(unsigned long max);
+
+#define timer_pending(timer) ((timer)->pprev != NULL)
+
+#endif
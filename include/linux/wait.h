@@ -0,0 +1,19 @@
+#ifndef _WAIT_H
+#define _WAIT_H
+
+/*
+ * A wait queue is a list of these, hanging off a 'struct wait_queue *'
+ * that starts out NULL. The entries live on the sleepers' stacks (see
+ * sleep_on() in kernel/sched.c). Exclusive waiters are kept after all
+ * the others, and wake_up() stops after the first of them, so that a
+ * single free resource doesn't wake everybody who wants one.
+ */
+struct wait_queue {
+	struct task_struct *task;
+	struct wait_queue *next;
+	int flags;
+};
+
+#define WQ_FLAG_EXCLUSIVE	0x01
+
+#endif
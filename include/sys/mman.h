@@ -0,0 +1,22 @@
+#ifndef _SYS_MMAN_H
+#define _SYS_MMAN_H
+
+#include <sys/types.h>
+
+#define PROT_NONE	0x0
+#define PROT_READ	0x1		/* page can be read */
+#define PROT_WRITE	0x2		/* page can be written */
+#define PROT_EXEC	0x4		/* page can be executed */
+
+#define MAP_SHARED	0x01		/* writes go back to the file */
+#define MAP_PRIVATE	0x02		/* changes are private */
+#define MAP_TYPE	0x0f		/* mask for type of mapping */
+#define MAP_FIXED	0x10		/* interpret addr exactly */
+#define MAP_ANONYMOUS	0x20		/* don't use a file */
+
+#define MAP_FAILED	((void *) -1)
+
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off);
+int munmap(void *addr, size_t len);
+
+#endif
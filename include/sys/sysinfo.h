@@ -0,0 +1,16 @@
+#ifndef _SYS_SYSINFO_H
+#define _SYS_SYSINFO_H
+
+/*
+ * Times are in clock ticks (HZ a second). The load averages are fixed
+ * point, with 11 bits after the point.
+ */
+struct sysinfo {
+	unsigned long uptime;		/* ticks since boot */
+	unsigned long idle;		/* ticks with nothing to run */
+	unsigned long loads[3];		/* 1, 5 and 15 minute averages */
+};
+
+extern int sysinfo(struct sysinfo *info);
+
+#endif
@@ -146,6 +146,13 @@
 #define __NR_lstat	84
 #define __NR_readlink	85
 #define __NR_uselib	86
+#define __NR_vfork	87
+#define __NR_mmap	88
+#define __NR_munmap	89
+#define __NR_swapon	90
+#define __NR_swapoff	91
+#define __NR_sysinfo	92
+#define __NR_fault_around	93
 
 #define _syscall0(type,name) \
 type name(void) \
@@ -225,6 +232,7 @@ volatile void exit(int status);
 volatile void _exit(int status);
 int fcntl(int fildes, int cmd, ...);
 /* int fork(void); */
+/* int vfork(void); */
 int getpid(void);
 int getuid(void);
 int geteuid(void);
@@ -276,5 +284,12 @@ int getgroups(int gidsetlen, gid_t * gidset);
 int setgroups(int gidsetlen, gid_t * gidset);
 int select(int width, fd_set * readfds, fd_set * writefds,
 	   fd_set * exceptfds, struct timeval *timeout);
+/* swapon() flags: use the priority in the low bits */
+#define SWAP_FLAG_PREFER	0x8000
+#define SWAP_FLAG_PRIO_MASK	0x7fff
+
+int swapon(const char *specialfile, int swap_flags);
+int swapoff(const char *specialfile);
+int fault_around(int pages);
 
 #endif
@@ -64,6 +64,8 @@ static int sprintf(char *str, const char *fmt, ...)
  * This is set up by the setup-routine at boot-time
  */
 #define EXT_MEM_K (*(unsigned short *)0x90002)
+#define E801_MEM_K (*(unsigned short *)0x90010)
+#define E801_MEM_64K (*(unsigned short *)0x90012)
 #define CON_ROWS ((*(unsigned short *)0x9000e) & 0xff)
 #define CON_COLS (((*(unsigned short *)0x9000e) & 0xff00) >> 8)
 #define DRIVE_INFO (*(struct drive_info *)0x90080)
@@ -138,9 +140,16 @@ void main(void)
 	envp_init[1] = term;
 	drive_info = DRIVE_INFO;
 	memory_end = (1 << 20) + (EXT_MEM_K << 10);
+	if (E801_MEM_K >= 15 * 1024) {	/* no hole below 16Mb */
+		memory_end = E801_MEM_64K;
+		if (memory_end > (TASK_SIZE >> 16))
+			memory_end = TASK_SIZE >> 16;
+		memory_end = (16 << 20) + (memory_end << 16);
+	}
 	memory_end &= 0xfffff000;
-	if (memory_end > 16 * 1024 * 1024)
-		memory_end = 16 * 1024 * 1024;
+/* the kernel maps all of physical memory below TASK_SIZE */
+	if (memory_end > TASK_SIZE)
+		memory_end = TASK_SIZE;
 	if (memory_end > 12 * 1024 * 1024)
 		buffer_memory_end = 4 * 1024 * 1024;
 	else if (memory_end > 6 * 1024 * 1024)
@@ -159,6 +168,8 @@ void main(void)
 	time_init();
 	sched_init();
 	buffer_init(buffer_memory_end);
+	inode_init();
+	file_table_init();
 	hd_init();
 	floppy_init();
 	sti();
@@ -171,7 +182,8 @@ void main(void)
  * signal to awaken, but task0 is the sole exception (see 'schedule()')
  * as task 0 gets activated at every idle moment (when no other tasks
  * can run). For task0 'pause()' just means we go check if some other
- * task can run, and if not we return here.
+ * task can run, and if not we halt until the next interrupt and return
+ * here.
  */
 	for (;;)
 __asm__("int $0x80"::"a"(__NR_pause):);
@@ -11,6 +11,10 @@
  * from the elevator-mechanism, but not so much as to lock a lot of
  * buffers when they are in the queue. 64 seems to be too many (easily
  * long pauses in reading when heavy writing/syncing is going on)
+ *
+ * The requests themselves come from an object cache that keeps room
+ * for NR_REQUEST of them, so the cache never has to grow and
+ * end_request() can free them at interrupt time.
  */
 #define NR_REQUEST	32
 
@@ -48,8 +52,9 @@ struct blk_dev_struct {
 };
 
 extern struct blk_dev_struct blk_dev[NR_BLK_DEV];
-extern struct request request[NR_REQUEST];
-extern struct task_struct *wait_for_request;
+extern struct wait_queue *wait_for_request;
+
+extern void free_request(struct request *req);
 
 extern int *blk_size[NR_BLK_DEV];
 
@@ -81,7 +86,8 @@ extern int *blk_size[NR_BLK_DEV];
 /* harddisk */
 #define DEVICE_NAME "harddisk"
 #define DEVICE_INTR do_hd
-#define DEVICE_TIMEOUT hd_timeout
+#define DEVICE_TIMEOUT hd_timer
+#define DEVICE_TIMEOUT_FN hd_times_out
 #define DEVICE_REQUEST do_hd_request
 #define DEVICE_NR(device) (MINOR(device)/5)
 #define DEVICE_ON(device)
@@ -100,8 +106,10 @@ extern int *blk_size[NR_BLK_DEV];
 void (*DEVICE_INTR) (void) = NULL;
 #endif
 #ifdef DEVICE_TIMEOUT
-int DEVICE_TIMEOUT = 0;
-#define SET_INTR(x) (DEVICE_INTR = (x),DEVICE_TIMEOUT = 200)
+static void DEVICE_TIMEOUT_FN(unsigned long);
+struct timer_list DEVICE_TIMEOUT = { NULL, NULL, 0, 0, DEVICE_TIMEOUT_FN };
+#define SET_INTR(x) (DEVICE_INTR = (x), \
+		     mod_timer(&DEVICE_TIMEOUT, jiffies + 200))
 #else
 #define SET_INTR(x) (DEVICE_INTR = (x))
 #endif
@@ -117,6 +125,8 @@ extern inline void unlock_buffer(struct buffer_head *bh)
 
 extern inline void end_request(int uptodate)
 {
+	struct request *req;
+
 	DEVICE_OFF(CURRENT->dev);
 	if (CURRENT->bh) {
 		CURRENT->bh->b_uptodate = uptodate;
@@ -127,14 +137,16 @@ extern inline void end_request(int uptodate)
 		printk("dev %04x, block %d\n\r", CURRENT->dev,
 		       CURRENT->bh->b_blocknr);
 	}
-	wake_up(&CURRENT->waiting);
+	if (CURRENT->waiting)
+		wake_up_process(CURRENT->waiting);
 	wake_up(&wait_for_request);
-	CURRENT->dev = -1;
-	CURRENT = CURRENT->next;
+	req = CURRENT;
+	CURRENT = req->next;
+	free_request(req);
 }
 
 #ifdef DEVICE_TIMEOUT
-#define CLEAR_DEVICE_TIMEOUT DEVICE_TIMEOUT = 0;
+#define CLEAR_DEVICE_TIMEOUT del_timer(&DEVICE_TIMEOUT);
 #else
 #define CLEAR_DEVICE_TIMEOUT
 #endif
@@ -129,7 +129,7 @@ static unsigned char seek_track = 0;
 static unsigned char current_track = 255;
 static unsigned char command = 0;
 unsigned char selected = 0;
-struct task_struct *wait_on_floppy_select = NULL;
+struct wait_queue *wait_on_floppy_select = NULL;
 
 void floppy_deselect(unsigned int nr)
 {
@@ -416,6 +416,35 @@ static void reset_floppy(void)
 	sti();
 }
 
+/*
+ * The floppy only ever has one timer running: it waits for the motor,
+ * then for the drive select to settle.
+ */
+static struct timer_list fd_timer;
+
+static void fd_timer_fn(unsigned long data)
+{
+	((void (*)(void))data) ();
+}
+
+static void fd_delay(int ticks, void (*fn) (void))
+{
+	unsigned long flags;
+
+	if (ticks <= 0) {
+		save_flags(flags);
+		cli();
+		fn();
+		restore_flags(flags);
+		return;
+	}
+	del_timer(&fd_timer);
+	fd_timer.expires = jiffies + ticks;
+	fd_timer.data = (unsigned long)fn;
+	fd_timer.function = fd_timer_fn;
+	add_timer(&fd_timer);
+}
+
 static void floppy_on_interrupt(void)
 {
 /* We cannot do a floppy-select, as that might sleep. We just force it */
@@ -424,7 +453,7 @@ static void floppy_on_interrupt(void)
 		current_DOR &= 0xFC;
 		current_DOR |= current_drive;
 		outb(current_DOR, FD_DOR);
-		add_timer(2, &transfer);
+		fd_delay(2, transfer);
 	} else
 		transfer();
 }
@@ -466,7 +495,7 @@ void do_fd_request(void)
 		command = FD_WRITE;
 	else
 		panic("do_fd_request: unknown command");
-	add_timer(ticks_to_floppy_on(current_drive), &floppy_on_interrupt);
+	fd_delay(ticks_to_floppy_on(current_drive), floppy_on_interrupt);
 }
 
 static int floppy_sizes[] = {
@@ -484,6 +513,7 @@ void floppy_init(void)
 {
 	blk_size[MAJOR_NR] = floppy_sizes;
 	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;
+	init_timer(&fd_timer);
 	set_trap_gate(0x26, &floppy_interrupt);
 	outb(inb_p(0x21) & ~0x40, 0x21);
 }
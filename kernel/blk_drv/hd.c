@@ -321,7 +321,7 @@ static void recal_intr(void)
 	do_hd_request();
 }
 
-void hd_times_out(void)
+static void hd_times_out(unsigned long dummy)
 {
 	if (!CURRENT)
 		return;
@@ -10,20 +10,23 @@
 #include <errno.h>
 #include <linux/sched.h>
 #include <linux/kernel.h>
+#include <linux/slab.h>
 #include <asm/system.h>
 
 #include "blk.h"
 
 /*
  * The request-struct contains all necessary data
- * to load a nr of sectors into memory
+ * to load a nr of sectors into memory. nr_requests
+ * is the number of them in use.
  */
-struct request request[NR_REQUEST];
+static struct kmem_cache *request_cache;
+static int nr_requests = 0;
 
 /*
  * used to wait on when there are no free requests
  */
-struct task_struct *wait_for_request = NULL;
+struct wait_queue *wait_for_request = NULL;
 
 /* blk_dev_struct is:
  *	do_request-address
@@ -65,6 +68,46 @@ static inline void unlock_buffer(struct buffer_head *bh)
 	wake_up(&bh->b_wait);
 }
 
+static void request_ctor(void *obj)
+{
+	struct request *req = (struct request *) obj;
+
+	req->dev = -1;
+	req->next = NULL;
+}
+
+/*
+ * Get a request if fewer than 'max' are in use.
+ */
+static struct request *get_request(int max)
+{
+	struct request *req = NULL;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (nr_requests < max &&
+	    (req = (struct request *) kmem_cache_alloc(request_cache)))
+		nr_requests++;
+	restore_flags(flags);
+	return req;
+}
+
+/*
+ * Called by end_request(), usually from an interrupt.
+ */
+void free_request(struct request *req)
+{
+	unsigned long flags;
+
+	request_ctor(req);
+	save_flags(flags);
+	cli();
+	kmem_cache_free(request_cache, req);
+	nr_requests--;
+	restore_flags(flags);
+}
+
 /*
  * add-request adds a request to the linked list.
  * It disables interrupts so that it can muck with the
@@ -129,16 +172,9 @@ repeat:
  * we want some room for reads: they take precedence. The last third
  * of the requests are only for reads.
  */
-	if (rw == READ)
-		req = request + NR_REQUEST;
-	else
-		req = request + ((NR_REQUEST * 2) / 3);
-/* find an empty request */
-	while (--req >= request)
-		if (req->dev < 0)
-			break;
-/* if none found, sleep on new requests: check for rw_ahead */
-	if (req < request) {
+	req = get_request(rw == READ ? NR_REQUEST : (NR_REQUEST * 2) / 3);
+/* if none free, sleep on new requests: check for rw_ahead */
+	if (!req) {
 		if (rw_ahead) {
 			unlock_buffer(bh);
 			return;
@@ -171,11 +207,7 @@ void ll_rw_page(int rw, int dev, int page, char *buffer)
 	if (rw != READ && rw != WRITE)
 		panic("Bad block dev command, must be R/W");
 repeat:
-	req = request + NR_REQUEST;
-	while (--req >= request)
-		if (req->dev < 0)
-			break;
-	if (req < request) {
+	if (!(req = get_request(NR_REQUEST))) {
 		sleep_on(&wait_for_request);
 		goto repeat;
 	}
@@ -208,10 +240,8 @@ void ll_rw_block(int rw, struct buffer_head *bh)
 
 void blk_dev_init(void)
 {
-	int i;
-
-	for (i = 0; i < NR_REQUEST; i++) {
-		request[i].dev = -1;
-		request[i].next = NULL;
-	}
+	request_cache = kmem_cache_create("request", sizeof(struct request),
+					  request_ctor, SLAB_ATOMIC);
+	if (!request_cache || !kmem_cache_reserve(request_cache, NR_REQUEST))
+		panic("Unable to get block requests");
 }
@@ -952,13 +952,13 @@ void update_screen(void)
 
 /* from bsd-net-2: */
 
-void sysbeepstop(void)
+static void sysbeepstop(unsigned long dummy)
 {
 	/* disable counter 2 */
 	outb(inb_p(0x61) & 0xFC, 0x61);
 }
 
-int beepcount = 0;
+static struct timer_list beep_timer = { NULL, NULL, 0, 0, sysbeepstop };
 
 static void sysbeep(void)
 {
@@ -970,7 +970,7 @@ static void sysbeep(void)
 	outb_p(0x37, 0x42);
 	outb(0x06, 0x42);
 	/* 1/8 second */
-	beepcount = HZ / 8;
+	mod_timer(&beep_timer, jiffies + HZ / 8);
 }
 
 int do_screendump(int arg)
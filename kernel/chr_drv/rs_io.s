@@ -79,6 +79,22 @@ end:	movb $0x20,%al
 jmp_table:
 	.long modem_status,write_char,read_char,line_status
 
+/*
+ * The write queue has a wait queue now, not a single task: let wake_up()
+ * deal with it. %ecx (the queue) and %edx (the port) are kept.
+ */
+.align 2
+wake_up_writer:
+	pushl %edx
+	pushl %ecx
+	leal proc_list(%ecx),%eax
+	pushl %eax
+	call _wake_up
+	addl $4,%esp
+	popl %ecx
+	popl %edx
+	ret
+
 .align 2
 modem_status:
 	addl $6,%edx		/* clear intr by reading modem status reg */
@@ -120,10 +136,9 @@ write_char:
 	je write_buffer_empty
 	cmpl $startup,%ebx
 	ja 1f
-	movl proc_list(%ecx),%ebx	# wake up sleeping process
-	testl %ebx,%ebx			# is there any?
-	je 1f
-	movl $0,(%ebx)
+	cmpl $0,proc_list(%ecx)		# wake up sleeping process
+	je 1f				# is there any?
+	call wake_up_writer
 1:	movl tail(%ecx),%ebx
 	movb buf(%ecx,%ebx),%al
 	outb %al,%dx
@@ -135,10 +150,9 @@ write_char:
 	ret
 .align 2
 write_buffer_empty:
-	movl proc_list(%ecx),%ebx	# wake up sleeping process
-	testl %ebx,%ebx			# is there any?
-	je 1f
-	movl $0,(%ebx)
+	cmpl $0,proc_list(%ecx)		# wake up sleeping process
+	je 1f				# is there any?
+	call wake_up_writer
 1:	incl %edx
 	inb %dx,%al
 	jmp 1f
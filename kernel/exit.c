@@ -38,6 +38,7 @@ void release(struct task_struct *p)
 				p->p_ysptr->p_osptr = p->p_osptr;
 			else
 				p->p_pptr->p_cptr = p->p_osptr;
+			free_page(p->tss.cr3);	/* pg_dir is never freed */
 			free_page((long)p);
 			schedule();
 			return;
@@ -142,7 +143,7 @@ static inline int send_sig(long sig, struct task_struct *p, int priv)
 		return -EPERM;
 	if ((sig == SIGKILL) || (sig == SIGCONT)) {
 		if (p->state == TASK_STOPPED)
-			p->state = TASK_RUNNING;
+			wake_up_process(p);
 		p->exit_code = 0;
 		p->signal &= ~((1 << (SIGSTOP - 1)) | (1 << (SIGTSTP - 1)) |
 			       (1 << (SIGTTIN - 1)) | (1 << (SIGTTOU - 1)));
@@ -155,6 +156,7 @@ static inline int send_sig(long sig, struct task_struct *p, int priv)
 		p->signal &= ~(1 << (SIGCONT - 1));
 	/* Actually deliver the signal */
 	p->signal |= (1 << (sig - 1));
+	signal_wake_up(p);
 	return 0;
 }
 
@@ -266,8 +268,14 @@ volatile void do_exit(long code)
 	struct task_struct *p;
 	int i;
 
-	free_page_tables(get_base(current->ldt[1]), get_limit(0x0f));
-	free_page_tables(get_base(current->ldt[2]), get_limit(0x17));
+	del_timer(&current->real_timer);
+	if (current->flags & PF_VFORK)
+		vfork_release(current, (unsigned long)pg_dir);
+	else {
+		exit_mmap();
+		free_page_tables(get_base(current->ldt[1]), get_limit(0x0f));
+		free_page_tables(get_base(current->ldt[2]), get_limit(0x17));
+	}
 	for (i = 0; i < NR_OPEN; i++)
 		if (current->filp[i])
 			sys_close(i);
@@ -275,10 +283,8 @@ volatile void do_exit(long code)
 	current->pwd = NULL;
 	iput(current->root);
 	current->root = NULL;
-	iput(current->executable);
-	current->executable = NULL;
-	iput(current->library);
-	current->library = NULL;
+	set_executable(current, NULL);
+	set_library(current, NULL);
 	current->state = TASK_ZOMBIE;
 	current->exit_code = code;
 	current->rss = 0;
@@ -300,6 +306,7 @@ volatile void do_exit(long code)
 	}
 	/* Let father know we died */
 	current->p_pptr->signal |= (1 << (SIGCHLD - 1));
+	signal_wake_up(current->p_pptr);
 
 	/*
 	 * This loop does two things:
@@ -312,8 +319,10 @@ volatile void do_exit(long code)
 	if (p = current->p_cptr) {
 		while (1) {
 			p->p_pptr = task[1];
-			if (p->state == TASK_ZOMBIE)
+			if (p->state == TASK_ZOMBIE) {
 				task[1]->signal |= (1 << (SIGCHLD - 1));
+				signal_wake_up(task[1]);
+			}
 			/*
 			 * process group orphan check
 			 * Case ii: Our child is in a different pgrp 
@@ -49,25 +49,39 @@ int copy_mem(int nr, struct task_struct *p)
 		panic("We don't support separate I&D");
 	if (data_limit < code_limit)
 		panic("Bad data_limit");
-	new_data_base = new_code_base = nr * TASK_SIZE;
+	new_data_base = new_code_base = TASK_SIZE;
 	p->start_code = new_code_base;
 	set_base(p->ldt[1], new_code_base);
 	set_base(p->ldt[2], new_data_base);
-	if (copy_page_tables(old_data_base, new_data_base, data_limit)) {
-		free_page_tables(new_data_base, data_limit);
+	if (copy_page_tables(p))
 		return -ENOMEM;
-	}
 	return 0;
 }
 
+/*
+ * A vfork()ed child hands the address space back to its parent when it
+ * execs or exits: it switches to the page directory 'dir', and the
+ * parent is woken up.
+ */
+void vfork_release(struct task_struct *p, unsigned long dir)
+{
+	p->tss.cr3 = dir;
+	if (p == current)
+		__asm__("movl %%eax,%%cr3"::"a" (dir));
+	p->mmap = NULL;		/* those were the parent's too */
+	p->flags &= ~PF_VFORK;
+	wake_up(&p->vfork_wait);
+}
+
 /*
  *  Ok, this is the main fork-routine. It copies the system process
  * information (task[nr]) and sets up the necessary registers. It
- * also copies the data segment in it's entirety.
+ * also copies the data segment in it's entirety, unless CLONE_VM
+ * says the child runs in our memory.
  */
-int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
-		 long ebx, long ecx, long edx, long orig_eax,
-		 long fs, long es, long ds,
+int copy_process(long clone_flags, int nr, long ebp, long edi, long esi,
+		 long gs, long none, long ebx, long ecx, long edx,
+		 long orig_eax, long fs, long es, long ds,
 		 long eip, long cs, long eflags, long esp, long ss)
 {
 	struct task_struct *p;
@@ -80,10 +94,12 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 	task[nr] = p;
 	*p = *current;		/* NOTE! this doesn't copy the supervisor stack */
 	p->state = TASK_UNINTERRUPTIBLE;
+	p->flags &= ~PF_VFORK;
+	p->vfork_wait = NULL;
 	p->pid = last_pid;
 	p->counter = p->priority;
 	p->signal = 0;
-	p->alarm = 0;
+	init_timer(&p->real_timer);	/* alarms don't inherit */
 	p->leader = 0;		/* process leadership doesn't inherit */
 	p->utime = p->stime = 0;
 	p->cutime = p->cstime = 0;
@@ -113,7 +129,17 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 	p->tss.trace_bitmap = 0x80000000;
 	if (last_task_used_math == current)
 		__asm__("clts ; fnsave %0 ; frstor %0"::"m"(p->tss.i387));
-	if (copy_mem(nr, p)) {
+	p->flt_rate = 0;
+	p->flt_stamp = jiffies;
+	p->swap_address = 0;
+	if (clone_flags & CLONE_VM)
+		p->rss = 0;
+	else if (dup_mmap(p)) {
+		task[nr] = NULL;
+		free_page((long)p);
+		return -EAGAIN;
+	} else if (copy_mem(nr, p)) {
+		free_mmap(p);
 		task[nr] = NULL;
 		free_page((long)p);
 		return -EAGAIN;
@@ -125,10 +151,15 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 		current->pwd->i_count++;
 	if (current->root)
 		current->root->i_count++;
-	if (current->executable)
+	p->executable = p->library = NULL;	/* not on their lists yet */
+	if (current->executable) {
 		current->executable->i_count++;
-	if (current->library)
+		set_executable(p, current->executable);
+	}
+	if (current->library) {
 		current->library->i_count++;
+		set_library(p, current->library);
+	}
 	set_tss_desc(gdt + (nr << 1) + FIRST_TSS_ENTRY, &(p->tss));
 	set_ldt_desc(gdt + (nr << 1) + FIRST_LDT_ENTRY, &(p->ldt));
 	p->p_pptr = current;
@@ -138,8 +169,13 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 	if (p->p_osptr)
 		p->p_osptr->p_ysptr = p;
 	current->p_cptr = p;
-	p->state = TASK_RUNNING;	/* do this last, just in case */
-	return last_pid;
+	if (clone_flags & CLONE_VFORK)
+		p->flags |= PF_VFORK;
+	wake_up_process(p);	/* do this last, just in case */
+	i = p->pid;
+	while (p->flags & PF_VFORK)
+		sleep_on(&p->vfork_wait);
+	return i;
 }
 
 int find_empty_process(void)
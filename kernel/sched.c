@@ -108,111 +108,345 @@ void math_state_restore()
 	}
 }
 
+/*
+ * The run queue. Runnable tasks other than the one running are on it,
+ * in one list per 'counter' value, so picking the task with the highest
+ * counter is a bit search rather than a scan of task[]. Tasks that have
+ * used up their counter go on the 'expired' array, filed by priority:
+ * when the active array runs dry the two are swapped, which is the old
+ * "counter = counter/2 + priority for everybody" step.
+ *
+ * That step isn't done to every task any more. Each task remembers the
+ * epoch (number of such swaps) its counter was last brought up to date
+ * in, and catches up when it is woken or picked, so sleepers still get
+ * the same bonus as before.
+ */
+#define NR_RUNQ		64
+
+struct prio_array {
+	unsigned long bitmap[NR_RUNQ / 32];
+	struct task_struct *head[NR_RUNQ], *tail[NR_RUNQ];
+};
+
+static struct prio_array prio_arrays[2];
+static struct prio_array *active = prio_arrays, *expired = prio_arrays + 1;
+static int nr_active = 0, nr_expired = 0;
+static unsigned long sched_epoch = 0;
+
+static inline void update_counter(struct task_struct *p)
+{
+	unsigned long n = sched_epoch - p->sched_epoch;
+
+	if (n > 32)		/* it has converged long before */
+		n = 32;
+	while (n--)
+		p->counter = (p->counter >> 1) + p->priority;
+	p->sched_epoch = sched_epoch;
+}
+
+static inline void enqueue_task(struct task_struct *p)
+{
+	struct prio_array *array;
+	int i;
+
+	update_counter(p);
+	if (p->counter > 0) {
+		array = active;
+		i = p->counter;
+		nr_active++;
+	} else {
+		array = expired;
+		i = p->priority;
+		nr_expired++;
+	}
+	if (i >= NR_RUNQ)
+		i = NR_RUNQ - 1;
+	p->run_next = NULL;
+	if (array->tail[i])
+		array->tail[i]->run_next = p;
+	else {
+		array->head[i] = p;
+		array->bitmap[i >> 5] |= 1 << (i & 31);
+	}
+	array->tail[i] = p;
+}
+
+static inline int last_bit(unsigned long word)
+{
+	int bit;
+
+	__asm__("bsrl %1,%0":"=r" (bit):"rm"(word));
+	return bit;
+}
+
+/*
+ * Take the task with the highest counter off the run queue, or return
+ * task[0] if there is nothing to run.
+ */
+static inline struct task_struct *dequeue_task(void)
+{
+	struct prio_array *array;
+	struct task_struct *p;
+	int i;
+
+	if (!nr_active) {
+		if (!nr_expired)
+			return task[0];
+		array = active;
+		active = expired;
+		expired = array;
+		nr_active = nr_expired;
+		nr_expired = 0;
+		sched_epoch++;
+	}
+	for (i = NR_RUNQ / 32 - 1; !active->bitmap[i]; i--)
+		/* nothing */ ;
+	i = (i << 5) + last_bit(active->bitmap[i]);
+	p = active->head[i];
+	if (!(active->head[i] = p->run_next)) {
+		active->tail[i] = NULL;
+		active->bitmap[i >> 5] &= ~(1 << (i & 31));
+	}
+	nr_active--;
+	update_counter(p);
+	return p;
+}
+
+/*
+ * Make 'p' runnable. A task that is already runnable is on the run
+ * queue, or is current and will be put there by schedule().
+ */
+void wake_up_process(struct task_struct *p)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (p->state != TASK_RUNNING && p->state != TASK_ZOMBIE) {
+		p->state = TASK_RUNNING;
+		if (p != current)
+			enqueue_task(p);
+	}
+	restore_flags(flags);
+}
+
+/*
+ * Wake 'p' if it is in an interruptible sleep and has a signal it will
+ * take. Call this after posting a signal to a task other than current.
+ */
+void signal_wake_up(struct task_struct *p)
+{
+	if (p->state == TASK_INTERRUPTIBLE &&
+	    (p->signal & ~(_BLOCKABLE & p->blocked)))
+		wake_up_process(p);
+}
+
+/*
+ * Number of runnable tasks, not counting task[0].
+ */
+int nr_running(void)
+{
+	return nr_active + nr_expired +
+	    (current != task[0] && current->state == TASK_RUNNING);
+}
+
+static void process_timeout(unsigned long data)
+{
+	struct task_struct *p = (struct task_struct *)data;
+
+	p->timeout = 0;
+	wake_up_process(p);
+}
+
 /*
  *  'schedule()' is the scheduler function. This is GOOD CODE! There
  * probably won't be any reason to change this, as it should work well
  * in all circumstances (ie gives IO-bound processes good response etc).
- * The one thing you might take a look at is the signal-handler code here.
+ *
+ * Whoever posts a signal wakes the task up, and a timeout is a timer
+ * that lives on our stack while we sleep, so all that is left here is
+ * to put current back on the run queue if it is still runnable and take
+ * the best task off it. That is done with interrupts off, so that a
+ * wake-up can't slip in between the two.
  *
  *   NOTE!!  Task 0 is the 'idle' task, which gets called when no other
  * tasks can run. It can not be killed, and it cannot sleep. The 'state'
- * information in task[0] is never used.
+ * information in task[0] is never used, and it is never on the run
+ * queue.
  */
 void schedule(void)
 {
-	int i, next, c;
-	struct task_struct **p;
+	struct task_struct *next;
+	struct timer_list timer;
+	unsigned long flags;
 
-/* check alarm, wake up any interruptible tasks that have got a signal */
-
-	for (p = &LAST_TASK; p > &FIRST_TASK; --p)
-		if (*p) {
-			if ((*p)->timeout && (*p)->timeout < jiffies) {
-				(*p)->timeout = 0;
-				if ((*p)->state == TASK_INTERRUPTIBLE)
-					(*p)->state = TASK_RUNNING;
-			}
-			if ((*p)->alarm && (*p)->alarm < jiffies) {
-				(*p)->signal |= (1 << (SIGALRM - 1));
-				(*p)->alarm = 0;
+	init_timer(&timer);
+	save_flags(flags);
+	cli();
+	if (current != task[0]) {
+		if (current->state == TASK_INTERRUPTIBLE) {
+			if (current->timeout && current->timeout < jiffies) {
+				current->timeout = 0;
+				current->state = TASK_RUNNING;
 			}
-			if (((*p)->signal & ~(_BLOCKABLE & (*p)->blocked)) &&
-			    (*p)->state == TASK_INTERRUPTIBLE)
-				(*p)->state = TASK_RUNNING;
+			if (current->signal & ~(_BLOCKABLE & current->blocked))
+				current->state = TASK_RUNNING;
 		}
-
-/* this is the scheduler proper: */
-
-	while (1) {
-		c = -1;
-		next = 0;
-		i = NR_TASKS;
-		p = &task[NR_TASKS];
-		while (--i) {
-			if (!*--p)
-				continue;
-			if ((*p)->state == TASK_RUNNING && (*p)->counter > c)
-				c = (*p)->counter, next = i;
+		if (current->state == TASK_RUNNING)
+			enqueue_task(current);
+		else if (current->state == TASK_INTERRUPTIBLE &&
+			 current->timeout) {
+			timer.expires = current->timeout;
+			timer.data = (unsigned long)current;
+			timer.function = process_timeout;
+			add_timer(&timer);
 		}
-		if (c)
-			break;
-		for (p = &LAST_TASK; p > &FIRST_TASK; --p)
-			if (*p)
-				(*p)->counter = ((*p)->counter >> 1) +
-				    (*p)->priority;
 	}
-	switch_to(next);
+	next = dequeue_task();
+	if (next != task[0])
+		start_tick();
+	switch_to(TASK_NR(next));
+	del_timer(&timer);
+	restore_flags(flags);
+}
+
+/*
+ * task[0] pauses when it has nothing to do: use that time to clear
+ * pages for get_free_page(), then stop the tick and halt until the next
+ * interrupt. The sti goes right before the hlt, so that an interrupt
+ * that wakes somebody up can't get in between and be slept through.
+ */
+static void cpu_idle(void)
+{
+	refill_zero_pool();
+	cli();
+	if (!nr_running()) {
+		stop_tick();
+		__asm__("sti ; hlt");
+	}
+	sti();
 }
 
 int sys_pause(void)
 {
+	if (current == task[0])
+		cpu_idle();
 	current->state = TASK_INTERRUPTIBLE;
 	schedule();
 	return 0;
 }
 
-static inline void __sleep_on(struct task_struct **p, int state)
+/*
+ * Wait queues. Exclusive waiters go at the end of the queue, so that
+ * wake_up() can wake all the others and then stop at the first of them.
+ * A waiter is only taken off the queue by itself, once it runs again, so
+ * a wake_up() that finds it already running just passes it by.
+ */
+void add_wait_queue(struct wait_queue **p, struct wait_queue *wait)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (wait->flags & WQ_FLAG_EXCLUSIVE) {
+		while (*p)
+			p = &(*p)->next;
+		wait->next = NULL;
+	} else
+		wait->next = *p;
+	*p = wait;
+	restore_flags(flags);
+}
+
+void remove_wait_queue(struct wait_queue **p, struct wait_queue *wait)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	for (; *p; p = &(*p)->next)
+		if (*p == wait) {
+			*p = wait->next;
+			break;
+		}
+	wait->next = NULL;
+	restore_flags(flags);
+}
+
+static inline void __sleep_on(struct wait_queue **p, int state, int flags)
 {
-	struct task_struct *tmp;
+	struct wait_queue wait;
+	unsigned long eflags;
 
 	if (!p)
 		return;
 	if (current == &(init_task.task))
 		panic("task[0] trying to sleep");
-	tmp = *p;
-	*p = current;
+	wait.task = current;
+	wait.flags = flags;
+	save_flags(eflags);
+	cli();
+	add_wait_queue(p, &wait);
 	current->state = state;
-repeat:schedule();
-	if (*p && *p != current) {
-		(**p).state = 0;
-		current->state = TASK_UNINTERRUPTIBLE;
-		goto repeat;
-	}
-	if (!*p)
-		printk("Warning: *P = NULL\n\r");
-	if (*p = tmp)
-		tmp->state = 0;
+	schedule();
+	remove_wait_queue(p, &wait);
+	restore_flags(eflags);
+}
+
+void interruptible_sleep_on(struct wait_queue **p)
+{
+	__sleep_on(p, TASK_INTERRUPTIBLE, 0);
 }
 
-void interruptible_sleep_on(struct task_struct **p)
+void sleep_on(struct wait_queue **p)
 {
-	__sleep_on(p, TASK_INTERRUPTIBLE);
+	__sleep_on(p, TASK_UNINTERRUPTIBLE, 0);
 }
 
-void sleep_on(struct task_struct **p)
+/*
+ * Like sleep_on(), but wake_up() wakes only one exclusive sleeper: for
+ * queues where whoever gets there first takes the only thing that was
+ * freed, and the rest would just go back to sleep.
+ */
+void sleep_on_exclusive(struct wait_queue **p)
 {
-	__sleep_on(p, TASK_UNINTERRUPTIBLE);
+	__sleep_on(p, TASK_UNINTERRUPTIBLE, WQ_FLAG_EXCLUSIVE);
 }
 
-void wake_up(struct task_struct **p)
+static inline void __wake_up(struct wait_queue **p, int all)
 {
-	if (p && *p) {
-		if ((**p).state == TASK_STOPPED)
+	struct wait_queue *wait;
+	struct task_struct *tsk;
+	unsigned long flags;
+
+	if (!p)
+		return;
+	save_flags(flags);
+	cli();
+	for (wait = *p; wait; wait = wait->next) {
+		tsk = wait->task;
+		if (tsk->state == TASK_STOPPED)
 			printk("wake_up: TASK_STOPPED");
-		if ((**p).state == TASK_ZOMBIE)
+		if (tsk->state == TASK_ZOMBIE)
 			printk("wake_up: TASK_ZOMBIE");
-		(**p).state = 0;
+		if (tsk->state != TASK_UNINTERRUPTIBLE &&
+		    tsk->state != TASK_INTERRUPTIBLE)
+			continue;
+		wake_up_process(tsk);
+		if (!all && (wait->flags & WQ_FLAG_EXCLUSIVE))
+			break;
 	}
+	restore_flags(flags);
+}
+
+void wake_up(struct wait_queue **p)
+{
+	__wake_up(p, 0);
+}
+
+void wake_up_all(struct wait_queue **p)
+{
+	__wake_up(p, 1);
 }
 
 /*
@@ -220,21 +454,49 @@ void wake_up(struct task_struct **p)
  * proper. They are here because the floppy needs a timer, and this
  * was the easiest way of doing it.
  */
-static struct task_struct *wait_motor[4] = { NULL, NULL, NULL, NULL };
-static int mon_timer[4] = { 0, 0, 0, 0 };
-static int moff_timer[4] = { 0, 0, 0, 0 };
+static struct wait_queue *wait_motor[4] = { NULL, NULL, NULL, NULL };
+
+static void motor_on_callback(unsigned long nr);
+static void motor_off_callback(unsigned long nr);
+
+/* spin-up of a motor, and the delay before an idle one is turned off */
+static struct timer_list motor_on_timer[4] = {
+	{ NULL, NULL, 0, 0, motor_on_callback },
+	{ NULL, NULL, 0, 1, motor_on_callback },
+	{ NULL, NULL, 0, 2, motor_on_callback },
+	{ NULL, NULL, 0, 3, motor_on_callback }
+};
+static struct timer_list motor_off_timer[4] = {
+	{ NULL, NULL, 0, 0, motor_off_callback },
+	{ NULL, NULL, 0, 1, motor_off_callback },
+	{ NULL, NULL, 0, 2, motor_off_callback },
+	{ NULL, NULL, 0, 3, motor_off_callback }
+};
 
 unsigned char current_DOR = 0x0C;
 
+static void motor_on_callback(unsigned long nr)
+{
+	wake_up(nr + wait_motor);
+}
+
+static void motor_off_callback(unsigned long nr)
+{
+	current_DOR &= ~(0x10 << nr);
+	outb(current_DOR, FD_DOR);
+}
+
 int ticks_to_floppy_on(unsigned int nr)
 {
 	extern unsigned char selected;
 	unsigned char mask = 0x10 << nr;
+	struct timer_list *on = motor_on_timer + nr;
+	int ticks = 0;
 
 	if (nr > 3)
 		panic("floppy_on: nr>3");
-	moff_timer[nr] = 10000;	/* 100 s = very big :-) */
 	cli();			/* use floppy_off to turn it off */
+	del_timer(motor_off_timer + nr);
 	mask |= current_DOR;
 	if (!selected) {
 		mask &= 0xFC;
@@ -243,13 +505,15 @@ int ticks_to_floppy_on(unsigned int nr)
 	if (mask != current_DOR) {
 		outb(mask, FD_DOR);
 		if ((mask ^ current_DOR) & 0xf0)
-			mon_timer[nr] = HZ / 2;
-		else if (mon_timer[nr] < 2)
-			mon_timer[nr] = 2;
+			mod_timer(on, jiffies + HZ / 2);
+		else if (!timer_pending(on) || (long)(on->expires - jiffies) < 2)
+			mod_timer(on, jiffies + 2);
 		current_DOR = mask;
 	}
+	if (timer_pending(on) && (ticks = on->expires - jiffies) < 1)
+		ticks = 1;
 	sti();
-	return mon_timer[nr];
+	return ticks;
 }
 
 void floppy_on(unsigned int nr)
@@ -262,104 +526,168 @@ void floppy_on(unsigned int nr)
 
 void floppy_off(unsigned int nr)
 {
-	moff_timer[nr] = 3 * HZ;
+	mod_timer(motor_off_timer + nr, jiffies + 3 * HZ);
 }
 
-void do_floppy_timer(void)
+/* gohigh 2004.3.14 */
+unsigned long avenrun[3] = { 0, 0, 0 };
+
+/*
+ * Nr of active tasks - counted in fixed - point numbers
+ */
+static unsigned long count_active_tasks(void)
 {
-	int i;
-	unsigned char mask = 0x10;
+	return nr_running() * FIXED_1;
+}
 
-	for (i = 0; i < 4; i++, mask <<= 1) {
-		if (!(mask & current_DOR))
-			continue;
-		if (mon_timer[i]) {
-			if (!--mon_timer[i])
-				wake_up(i + wait_motor);
-		} else if (!moff_timer[i]) {
-			current_DOR &= ~mask;
-			outb(current_DOR, FD_DOR);
-		} else
-			moff_timer[i]--;
-	}
+static inline void calc_load(void)
+{
+	unsigned long active_tasks;	/* fixed-point */
+	static unsigned long next = LOAD_FREQ;
+
+	if ((long)(jiffies - next) < 0)
+		return;
+	next += LOAD_FREQ;
+	active_tasks = count_active_tasks();
+	CALC_LOAD(avenrun[0], EXP_1, active_tasks);
+	CALC_LOAD(avenrun[1], EXP_5, active_tasks);
+	CALC_LOAD(avenrun[2], EXP_15, active_tasks);
 }
 
-#define TIME_REQUESTS 64
+/*
+ * Dynamic tick. When task 0 has nothing to run, the PIT is set to
+ * interrupt just once, when the next timer is due, instead of every
+ * 1/HZ. Its counter is only 16 bits, so that is at most MAX_IDLE_TICKS
+ * away. The screen blanking countdown, which do_timer() still runs by
+ * hand, limits how long it stops.
+ *
+ * The periodic tick comes back with the one-shot interrupt, or earlier
+ * if something wakes a task or adds a timer in the meantime: jiffies
+ * and task 0's time are brought up to date from how far the PIT got.
+ * The periodic tick runs in mode 2, which counts down one by one, so
+ * the part of a tick that has gone by when it stops can be read too.
+ * What doesn't make up a whole tick is kept in idle_frac, and the next
+ * one-shot is that much shorter.
+ */
+#define MAX_IDLE_TICKS	(0xffff / LATCH)
+
+static unsigned long idle_ticks = 0;	/* PIT is one-shot for this many */
+static unsigned long idle_len = 0;	/* PIT counts it was set to */
+static unsigned long idle_frac = 0;	/* PIT counts short of a tick */
 
-static struct timer_list {
-	long jiffies;
-	void (*fn) ();
-	struct timer_list *next;
-} timer_list[TIME_REQUESTS], *next_timer = NULL;
+static inline void set_pit(int mode, unsigned long count)
+{
+	outb_p(0x30 | (mode << 1), 0x43);	/* binary, LSB/MSB, ch 0 */
+	outb_p(count & 0xff, 0x40);	/* LSB */
+	outb(count >> 8, 0x40);	/* MSB */
+}
 
-void add_timer(long jiffies, void (*fn) (void))
+static inline unsigned long read_pit(void)
 {
-	struct timer_list *p;
+	unsigned long count;
 
-	if (!fn)
-		return;
+	outb_p(0x00, 0x43);	/* latch ch 0 */
+	count = inb_p(0x40);
+	count |= inb_p(0x40) << 8;
+	return count;
+}
+
+static inline int pit_irq_pending(void)
+{
+	outb_p(0x0a, 0x20);	/* OCW3: read IRR */
+	return inb_p(0x20) & 1;
+}
+
+static void idle_ticks_passed(unsigned long ticks)
+{
+	jiffies += ticks;
+	task[0]->stime += ticks;
+	if (blankcount > ticks)
+		blankcount -= ticks;
+	else if (blankcount)
+		blankcount = 1;	/* let do_timer() blank it */
+}
+
+void stop_tick(void)
+{
+	unsigned long flags, count, ticks = MAX_IDLE_TICKS, caught_up = 0;
+
+	save_flags(flags);
 	cli();
-	if (jiffies <= 0)
-		(fn) ();
-	else {
-		for (p = timer_list; p < timer_list + TIME_REQUESTS; p++)
-			if (!p->fn)
-				break;
-		if (p >= timer_list + TIME_REQUESTS)
-			panic("No more time requests free");
-		p->fn = fn;
-		p->jiffies = jiffies;
-		p->next = next_timer;
-		next_timer = p;
-		while (p->next && p->next->jiffies < p->jiffies) {
-			p->jiffies -= p->next->jiffies;
-			fn = p->fn;
-			p->fn = p->next->fn;
-			p->next->fn = fn;
-			jiffies = p->jiffies;
-			p->jiffies = p->next->jiffies;
-			p->next->jiffies = jiffies;
-			p = p->next;
-		}
+	if (idle_ticks || nr_running())
+		goto out;
+	if (blankcount && blankcount < ticks)
+		ticks = blankcount;
+	if ((ticks = next_timer_interrupt(ticks)) < 2)
+		goto out;
+	count = read_pit();
+	if (pit_irq_pending() || !count || count > LATCH)
+		goto out;	/* a periodic tick is due: let it in */
+	count = idle_frac + LATCH - count;
+	if (count >= LATCH) {	/* a whole tick owed already */
+		count -= LATCH;
+		ticks--;
+		caught_up = 1;
 	}
-	sti();
+	set_pit(0, ticks * LATCH - count);
+	if (pit_irq_pending()) {	/* a periodic tick got in first */
+		set_pit(2, LATCH);
+		goto out;
+	}
+	idle_ticks_passed(caught_up);
+	idle_len = ticks * LATCH - count;
+	idle_frac = count;
+	idle_ticks = ticks;
+out:
+	restore_flags(flags);
 }
 
-/* gohigh 2004.3.14 */
-unsigned long avenrun[3] = { 0, 0, 0 };
-
 /*
- * Nr of active tasks - counted in fixed - point numbers
+ * Back to the periodic tick. Once the one-shot has run out, its counter
+ * wraps and goes on counting down from 0xffff, which tells us how late
+ * we are. If it has gone off, its interrupt counts the last tick.
  */
-static unsigned long count_active_tasks(void)
+static void end_idle(int fired)
 {
-	struct task_struct **p;
-	unsigned long nr = 0;
-
-	for (p = &LAST_TASK; p > &FIRST_TASK; --p)
-		if (*p && (*p)->state == TASK_RUNNING)
-			nr += FIXED_1;
-	return nr;
+	unsigned long count, done;
+
+	count = read_pit();
+	set_pit(2, LATCH);
+	if (!count || count > idle_len) {
+		done = idle_len + ((0x10000 - count) & 0xffff);
+		fired = 1;
+	} else if (fired || pit_irq_pending()) {
+		done = idle_len;
+		fired = 1;
+	} else
+		done = idle_len - count;
+	done += idle_frac;
+	if (fired)
+		done -= LATCH;
+	idle_ticks_passed(done / LATCH);
+	idle_frac = done % LATCH;
+	idle_ticks = 0;
 }
 
-static inline void calc_load(void)
+void start_tick(void)
 {
-	unsigned long active_tasks;	/* fixed-point */
-	static int count = LOAD_FREQ;
+	unsigned long flags;
 
-	if (count-- > 0)
+	if (!idle_ticks)
 		return;
-	count = LOAD_FREQ;
-	active_tasks = count_active_tasks();
-	CALC_LOAD(avenrun[0], EXP_1, active_tasks);
-	CALC_LOAD(avenrun[1], EXP_5, active_tasks);
-	CALC_LOAD(avenrun[2], EXP_15, active_tasks);
+	save_flags(flags);
+	cli();
+	if (idle_ticks)
+		end_idle(0);
+	restore_flags(flags);
 }
 
 void do_timer(long cpl)
 {
 	static int blanked = 0;
 
+	if (idle_ticks)		/* the one-shot: the interrupt was the last */
+		end_idle(1);
 	calc_load();
 	if (blankcount || !blankinterval) {
 		if (blanked)
@@ -371,32 +699,12 @@ void do_timer(long cpl)
 		blank_screen();
 		blanked = 1;
 	}
-	if (hd_timeout)
-		if (!--hd_timeout)
-			hd_times_out();
-
-	if (beepcount)
-		if (!--beepcount)
-			sysbeepstop();
-
 	if (cpl)
 		current->utime++;
 	else
 		current->stime++;
 
-	if (next_timer) {
-		next_timer->jiffies--;
-		while (next_timer && next_timer->jiffies <= 0) {
-			void (*fn) (void);
-
-			fn = next_timer->fn;
-			next_timer->fn = NULL;
-			next_timer = next_timer->next;
-			(fn) ();
-		}
-	}
-	if (current_DOR & 0xf0)
-		do_floppy_timer();
+	run_timers();
 	if ((--current->counter) > 0)
 		return;
 	current->counter = 0;
@@ -405,13 +713,27 @@ void do_timer(long cpl)
 	schedule();
 }
 
-int sys_alarm(long seconds)
+static void it_real_fn(unsigned long data)
 {
-	int old = current->alarm;
+	struct task_struct *p = (struct task_struct *)data;
 
-	if (old)
-		old = (old - jiffies) / HZ;
-	current->alarm = (seconds > 0) ? (jiffies + HZ * seconds) : 0;
+	p->signal |= (1 << (SIGALRM - 1));
+	signal_wake_up(p);
+}
+
+int sys_alarm(long seconds)
+{
+	struct timer_list *timer = &current->real_timer;
+	int old = 0;
+
+	if (del_timer(timer))
+		old = (timer->expires - jiffies) / HZ;
+	if (seconds > 0) {
+		timer->expires = jiffies + HZ * seconds;
+		timer->data = (unsigned long)current;
+		timer->function = it_real_fn;
+		add_timer(timer);
+	}
 	return (old);
 }
 
@@ -473,9 +795,7 @@ void sched_init(void)
 	__asm__("pushfl ; andl $0xffffbfff,(%esp) ; popfl");
 	ltr(0);
 	lldt(0);
-	outb_p(0x36, 0x43);	/* binary, mode 3, LSB/MSB, ch 0 */
-	outb_p(LATCH & 0xff, 0x40);	/* LSB */
-	outb(LATCH >> 8, 0x40);	/* MSB */
+	set_pit(2, LATCH);
 	set_intr_gate(0x20, &timer_interrupt);
 	outb(inb_p(0x21) & ~0x01, 0x21);
 	set_system_gate(0x80, &system_call);
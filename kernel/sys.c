@@ -12,6 +12,7 @@
 #include <linux/config.h>
 #include <asm/segment.h>
 #include <sys/times.h>
+#include <sys/sysinfo.h>
 #include <sys/utsname.h>
 #include <sys/param.h>
 #include <sys/resource.h>
@@ -222,8 +223,25 @@ int sys_times(struct tms *tbuf)
 	return jiffies;
 }
 
+/*
+ * Task 0 only runs when nothing else can, so its time is the idle time.
+ */
+int sys_sysinfo(struct sysinfo *info)
+{
+	int i;
+
+	verify_area(info, sizeof *info);
+	put_fs_long(jiffies, &info->uptime);
+	put_fs_long(task[0]->utime + task[0]->stime, &info->idle);
+	for (i = 0; i < 3; i++)
+		put_fs_long(avenrun[i], info->loads + i);
+	return 0;
+}
+
 int sys_brk(unsigned long end_data_seg)
 {
+	if (current->mmap && end_data_seg > current->mmap->vm_start)
+		return current->brk;	/* would run into a mapping */
 	if (end_data_seg >= current->end_code &&
 	    end_data_seg < current->start_stack - 16384)
 		current->brk = end_data_seg;
@@ -33,6 +33,9 @@
 
 SIG_CHLD	= 17
 
+CLONE_VM	= 0x00000100	# these must match linux/sched.h
+CLONE_VFORK	= 0x00004000
+
 EAX		= 0x00
 EBX		= 0x04
 ECX		= 0x08
@@ -68,7 +71,7 @@ ENOSYS = 38
  * Ok, I get parallel printer interrupts while using the floppy for some
  * strange reason. Urgel. Now I just ignore them.
  */
-.globl _system_call,_sys_fork,_timer_interrupt,_sys_execve
+.globl _system_call,_sys_fork,_sys_vfork,_timer_interrupt,_sys_execve
 .globl _hd_interrupt,_floppy_interrupt,_parallel_interrupt
 .globl _device_not_available, _coprocessor_error
 
@@ -228,8 +231,24 @@ _sys_fork:
 	pushl %edi
 	pushl %ebp
 	pushl %eax
+	pushl $0		# clone_flags
 	call _copy_process
-	addl $20,%esp
+	addl $24,%esp
+1:	ret
+
+.align 2
+_sys_vfork:
+	call _find_empty_process
+	testl %eax,%eax
+	js 1f
+	push %gs
+	pushl %esi
+	pushl %edi
+	pushl %ebp
+	pushl %eax
+	pushl $CLONE_VM+CLONE_VFORK
+	call _copy_process
+	addl $24,%esp
 1:	ret
 
 _hd_interrupt:
@@ -248,13 +267,16 @@ _hd_interrupt:
 	outb %al,$0xA0		# EOI to interrupt controller #1
 	jmp 1f			# give port chance to breathe
 1:	jmp 1f
-1:	xorl %edx,%edx
-	movl %edx,_hd_timeout
+1:	pushl $_hd_timer
+	call _del_timer		# the interrupt came: no timeout
+	addl $4,%esp
+	xorl %edx,%edx
 	xchgl _do_hd,%edx
 	testl %edx,%edx
 	jne 1f
 	movl $_unexpected_hd_interrupt,%edx
-1:	outb %al,$0x20
+1:	movb $0x20,%al
+	outb %al,$0x20
 	call *%edx		# "interesting" way of handling intr.
 	pop %fs
 	pop %es
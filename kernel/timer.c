@@ -0,0 +1,213 @@
+/*
+ *  linux/kernel/timer.c
+ */
+
+/*
+ * Kernel timers are kept on a hierarchical timing wheel, so adding and
+ * deleting one is O(1) and there is no limit on how many there are.
+ *
+ * The first wheel has a slot for each of the next 256 jiffies. The four
+ * others have 64 slots each, and each of their slots covers a whole
+ * turn of the wheel below it, which between them covers all 32 bits of
+ * 'expires'. Every time the first wheel comes round, the next slot of
+ * the second one is emptied into it, and so on up: a timer is moved at
+ * most four times before it runs.
+ */
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/timer.h>
+#include <asm/system.h>
+
+#define TVN_BITS 6
+#define TVR_BITS 8
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVR_MASK (TVR_SIZE - 1)
+
+struct timer_vec {
+	int index;
+	struct timer_list *vec[TVN_SIZE];
+};
+
+struct timer_vec_root {
+	int index;
+	struct timer_list *vec[TVR_SIZE];
+};
+
+static struct timer_vec tv5 = { 0, };
+static struct timer_vec tv4 = { 0, };
+static struct timer_vec tv3 = { 0, };
+static struct timer_vec tv2 = { 0, };
+static struct timer_vec_root tv1 = { 0, };
+
+static struct timer_vec *const tvecs[] = {
+	(struct timer_vec *)&tv1, &tv2, &tv3, &tv4, &tv5
+};
+
+#define NOOF_TVECS (sizeof(tvecs) / sizeof(tvecs[0]))
+
+/* the jiffy the wheels have been run up to */
+static unsigned long timer_jiffies = 0;
+
+static inline void internal_add_timer(struct timer_list *timer)
+{
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - timer_jiffies;
+	struct timer_list **vec;
+
+	if (idx < TVR_SIZE)
+		vec = tv1.vec + (expires & TVR_MASK);
+	else if (idx < 1 << (TVR_BITS + TVN_BITS))
+		vec = tv2.vec + ((expires >> TVR_BITS) & TVN_MASK);
+	else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS))
+		vec = tv3.vec + ((expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK);
+	else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS))
+		vec = tv4.vec +
+		    ((expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK);
+	else if ((signed long)idx < 0)
+		/* in the past: run it on the next tick */
+		vec = tv1.vec + tv1.index;
+	else
+		vec = tv5.vec +
+		    ((expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK);
+	if ((timer->next = *vec) != NULL)
+		timer->next->pprev = &timer->next;
+	*vec = timer;
+	timer->pprev = vec;
+}
+
+static inline void detach_timer(struct timer_list *timer)
+{
+	if (timer->next)
+		timer->next->pprev = timer->pprev;
+	*timer->pprev = timer->next;
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+/*
+ * While the tick is stopped jiffies lags behind, so an interrupt handler
+ * that sets a timer for 'jiffies + n' would get it that much too early.
+ * Bring jiffies up to date first, and move the timer along with it.
+ */
+static inline void catch_up_tick(struct timer_list *timer)
+{
+	unsigned long stale = jiffies;
+
+	start_tick();
+	timer->expires += jiffies - stale;
+}
+
+void init_timer(struct timer_list *timer)
+{
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+void add_timer(struct timer_list *timer)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (timer->pprev) {
+		restore_flags(flags);
+		printk("add_timer: timer already pending\n\r");
+		return;
+	}
+	catch_up_tick(timer);
+	internal_add_timer(timer);
+	restore_flags(flags);
+}
+
+/*
+ * Returns 1 if the timer was pending.
+ */
+int del_timer(struct timer_list *timer)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	save_flags(flags);
+	cli();
+	if (timer->pprev) {
+		detach_timer(timer);
+		ret = 1;
+	}
+	restore_flags(flags);
+	return ret;
+}
+
+void mod_timer(struct timer_list *timer, unsigned long expires)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (timer->pprev)
+		detach_timer(timer);
+	timer->expires = expires;
+	catch_up_tick(timer);
+	internal_add_timer(timer);
+	restore_flags(flags);
+}
+
+/*
+ * How many ticks from now until a timer may be due, looking no further
+ * than 'max' ahead. Only the first wheel is looked at, so we stop short
+ * where it will next be refilled from the second one.
+ */
+unsigned long next_timer_interrupt(unsigned long max)
+{
+	unsigned long n;
+	int idx = tv1.index;
+
+	if (timer_jiffies != jiffies + 1)	/* wheels not run up to now */
+		return 1;
+	for (n = 1; n < max; n++, idx = (idx + 1) & TVR_MASK)
+		if (tv1.vec[idx] || idx == TVR_MASK)
+			break;
+	return n;
+}
+
+static inline void cascade_timers(struct timer_vec *tv)
+{
+	struct timer_list *timer, *next;
+
+	next = tv->vec[tv->index];
+	tv->vec[tv->index] = NULL;
+	while ((timer = next) != NULL) {
+		next = timer->next;
+		internal_add_timer(timer);
+	}
+	tv->index = (tv->index + 1) & TVN_MASK;
+}
+
+/*
+ * Called from do_timer() with interrupts off: run everything that has
+ * expired up to and including this tick.
+ */
+void run_timers(void)
+{
+	struct timer_list *timer;
+	void (*fn) (unsigned long);
+	int n;
+
+	while ((long)(jiffies - timer_jiffies) >= 0) {
+		if (!tv1.index) {
+			n = 1;
+			do {
+				cascade_timers(tvecs[n]);
+			} while (tvecs[n]->index == 1 && ++n < NOOF_TVECS);
+		}
+		while ((timer = tv1.vec[tv1.index]) != NULL) {
+			fn = timer->function;
+			detach_timer(timer);
+			fn(timer->data);
+		}
+		timer_jiffies++;
+		tv1.index = (tv1.index + 1) & TVR_MASK;
+	}
+}
@@ -21,8 +21,8 @@
  * stored on pages requested from get_free_page().  However, unlike buckets,
  * pages devoted to bucket descriptor pages are never released back to the
  * system.  Fortunately, a system should probably only need 1 or 2 bucket
- * descriptor pages, since a page can hold 256 bucket descriptors (which
- * corresponds to 1 megabyte worth of bucket pages.)  If the kernel is using 
+ * descriptor pages, since a page can hold 204 bucket descriptors (which
+ * corresponds to 800k worth of bucket pages.)  If the kernel is using 
  * that much allocated memory, it's probably doing something wrong.  :-)
  *
  * Note: malloc() and free() both call get_free_page() and free_page()
@@ -49,17 +49,26 @@
 #include <linux/mm.h>
 #include <asm/system.h>
 
-struct bucket_desc {		/* 16 bytes */
+struct bucket_desc {		/* 20 bytes */
 	void *page;
 	struct bucket_desc *next;
+	struct bucket_desc *prev;
 	void *freeptr;
 	unsigned short refcnt;
 	unsigned short bucket_size;
 };
 
-struct _bucket_dir {		/* 8 bytes */
+/*
+ * Buckets with free objects are on 'chain', full ones on 'full', so that
+ * malloc() can always take the first bucket on the chain. free_s() finds
+ * the bucket of an object through mem_map[] (the page is marked
+ * PG_bucket, and 'private' points at the descriptor), so it doesn't have
+ * to search any lists either.
+ */
+struct _bucket_dir {		/* 12 bytes */
 	int size;
 	struct bucket_desc *chain;
+	struct bucket_desc *full;
 };
 
 /*
@@ -75,16 +84,16 @@ struct _bucket_dir {		/* 8 bytes */
  * Note that this list *must* be kept in order.
  */
 struct _bucket_dir bucket_dir[] = {
-	{16, (struct bucket_desc *)0},
-	{32, (struct bucket_desc *)0},
-	{64, (struct bucket_desc *)0},
-	{128, (struct bucket_desc *)0},
-	{256, (struct bucket_desc *)0},
-	{512, (struct bucket_desc *)0},
-	{1024, (struct bucket_desc *)0},
-	{2048, (struct bucket_desc *)0},
-	{4096, (struct bucket_desc *)0},
-	{0, (struct bucket_desc *)0}
+	{16, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{32, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{64, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{128, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{256, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{512, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{1024, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{2048, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{4096, (struct bucket_desc *)0, (struct bucket_desc *)0},
+	{0, (struct bucket_desc *)0, (struct bucket_desc *)0}
 };				/* End of list marker */
 
 /*
@@ -115,11 +124,32 @@ static inline void init_bucket_desc()
 	free_bucket_desc = first;
 }
 
+static inline void unlink_bucket(struct bucket_desc **list,
+				 struct bucket_desc *bdesc)
+{
+	if (bdesc->next)
+		bdesc->next->prev = bdesc->prev;
+	if (bdesc->prev)
+		bdesc->prev->next = bdesc->next;
+	else
+		*list = bdesc->next;
+}
+
+static inline void link_bucket(struct bucket_desc **list,
+			       struct bucket_desc *bdesc)
+{
+	bdesc->prev = (struct bucket_desc *)0;
+	if ((bdesc->next = *list) != 0)
+		bdesc->next->prev = bdesc;
+	*list = bdesc;
+}
+
 void *malloc(unsigned int len)
 {
 	struct _bucket_dir *bdir;
 	struct bucket_desc *bdesc;
 	void *retval;
+	unsigned long flags;
 
 	/*
 	 * First we search the bucket_dir to find the right bucket change
@@ -134,15 +164,13 @@ void *malloc(unsigned int len)
 		panic("malloc: bad arg");
 	}
 	/*
-	 * Now we search for a bucket descriptor which has free space
+	 * Any bucket on the chain has free space
 	 */
+	save_flags(flags);
 	cli();			/* Avoid race conditions */
-	for (bdesc = bdir->chain; bdesc; bdesc = bdesc->next)
-		if (bdesc->freeptr)
-			break;
+	bdesc = bdir->chain;
 	/*
-	 * If we didn't find a bucket with free space, then we'll 
-	 * allocate a new one.
+	 * If there is none, then we'll allocate a new one.
 	 */
 	if (!bdesc) {
 		char *cp;
@@ -164,70 +192,62 @@ void *malloc(unsigned int len)
 			cp += bdir->size;
 		}
 		*((char **)cp) = 0;
-		bdesc->next = bdir->chain;	/* OK, link it in! */
-		bdir->chain = bdesc;
+		mem_map[MAP_NR((unsigned long)bdesc->page)].flags |= PG_bucket;
+		mem_map[MAP_NR((unsigned long)bdesc->page)].private =
+		    (unsigned long)bdesc;
+		link_bucket(&bdir->chain, bdesc);	/* OK, link it in! */
 	}
 	retval = (void *)bdesc->freeptr;
 	bdesc->freeptr = *((void **)retval);
 	bdesc->refcnt++;
-	sti();			/* OK, we're safe again */
+	if (!bdesc->freeptr) {
+		unlink_bucket(&bdir->chain, bdesc);
+		link_bucket(&bdir->full, bdesc);
+	}
+	restore_flags(flags);	/* OK, we're safe again */
 	return (retval);
 }
 
 /*
- * Here is the free routine.  If you know the size of the object that you
- * are freeing, then free_s() will use that information to speed up the
- * search for the bucket descriptor.
- * 
+ * Here is the free routine. The size isn't needed any more, but if it is
+ * given it is checked against the bucket.
+ *
  * We will #define a macro so that "free(x)" is becomes "free_s(x, 0)"
  */
 void free_s(void *obj, int size)
 {
-	void *page;
+	unsigned long page;
 	struct _bucket_dir *bdir;
-	struct bucket_desc *bdesc, *prev;
+	struct bucket_desc *bdesc;
+	unsigned long flags;
 
 	/* Calculate what page this object lives in */
-	page = (void *)((unsigned long)obj & 0xfffff000);
-	/* Now search the buckets looking for that page */
-	for (bdir = bucket_dir; bdir->size; bdir++) {
-		prev = 0;
-		/* If size is zero then this conditional is always false */
-		if (bdir->size < size)
-			continue;
-		for (bdesc = bdir->chain; bdesc; bdesc = bdesc->next) {
-			if (bdesc->page == page)
-				goto found;
-			prev = bdesc;
-		}
-	}
-	panic("Bad address passed to kernel free_s()");
-found:
+	page = (unsigned long)obj & 0xfffff000;
+	if (page < LOW_MEM || page >= HIGH_MEMORY ||
+	    !(mem_map[MAP_NR(page)].flags & PG_bucket))
+		panic("Bad address passed to kernel free_s()");
+	bdesc = (struct bucket_desc *)mem_map[MAP_NR(page)].private;
+	if (bdesc->bucket_size < size)
+		panic("Bad size passed to kernel free_s()");
+	for (bdir = bucket_dir; bdir->size != bdesc->bucket_size; bdir++)
+		/* nothing */ ;
+	save_flags(flags);
 	cli();			/* To avoid race conditions */
+	if (!bdesc->freeptr) {	/* it was full: back to the chain */
+		unlink_bucket(&bdir->full, bdesc);
+		link_bucket(&bdir->chain, bdesc);
+	}
 	*((void **)obj) = bdesc->freeptr;
 	bdesc->freeptr = obj;
 	bdesc->refcnt--;
 	if (bdesc->refcnt == 0) {
-		/*
-		 * We need to make sure that prev is still accurate.  It
-		 * may not be, if someone rudely interrupted us....
-		 */
-		if ((prev && (prev->next != bdesc)) ||
-		    (!prev && (bdir->chain != bdesc)))
-			for (prev = bdir->chain; prev; prev = prev->next)
-				if (prev->next == bdesc)
-					break;
-		if (prev)
-			prev->next = bdesc->next;
-		else {
-			if (bdir->chain != bdesc)
-				panic("malloc bucket chains corrupted");
-			bdir->chain = bdesc->next;
-		}
-		free_page((unsigned long)bdesc->page);
+		unlink_bucket(&bdir->chain, bdesc);
+		mem_map[MAP_NR(page)].flags &= ~PG_bucket;
+		mem_map[MAP_NR(page)].private = 0;
+		free_page(page);
 		bdesc->next = free_bucket_desc;
 		free_bucket_desc = bdesc;
 	}
-	sti();
+	restore_flags(flags);
 	return;
 }
@@ -0,0 +1,218 @@
+/*
+ *  linux/mm/filemap.c
+ */
+
+/*
+ * The page cache holds the pages of MAP_SHARED file mappings, so that
+ * all tasks mapping a file see the same pages, and read() and write()
+ * see them too. A page is found by (inode, offset) through a hash
+ * table, and its struct page says whose it is. The cache keeps a
+ * reference of its own, on top of those of the page table entries.
+ *
+ * A cached page is what the file looks like: read() takes the data from
+ * it, and write() changes it along with the buffer cache. What is
+ * written through a mapping goes to the buffer cache when it is
+ * unmapped, or before the page leaves the cache. The swapper never
+ * writes these pages to swap: it just takes them out of the page table,
+ * leaving PG_dirty set if they were written to.
+ *
+ * Pages nobody maps stay cached until the inode is released, or until
+ * memory is short and shrink_page_cache() gets them.
+ */
+
+#include <string.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+
+#define PAGE_HASH_SIZE	256
+#define page_hashfn(inode,offset) \
+	((((unsigned long) (inode) >> 6) ^ ((offset) >> 12)) & \
+	 (PAGE_HASH_SIZE - 1))
+
+#define page_address(p)	(LOW_MEM + (((p) - mem_map) << 12))
+
+static struct page *page_hash_table[PAGE_HASH_SIZE] = { NULL, };
+int nr_cache_pages = 0;
+
+/*
+ * Returns the cached page at 'offset' of 'inode', 0 if there is none.
+ * No reference is taken: take one before anything that may sleep.
+ */
+unsigned long find_page(struct m_inode *inode, unsigned long offset)
+{
+	struct page *p;
+
+	for (p = page_hash_table[page_hashfn(inode, offset)]; p;
+	     p = p->next_hash)
+		if (p->inode == inode && p->offset == offset)
+			return page_address(p);
+	return 0;
+}
+
+static void add_to_page_cache(unsigned long page, struct m_inode *inode,
+			      unsigned long offset)
+{
+	struct page *p = mem_map + MAP_NR(page);
+	struct page **hash = page_hash_table + page_hashfn(inode, offset);
+
+	p->inode = inode;
+	p->offset = offset;
+	p->flags &= ~PG_dirty;
+	p->next_hash = *hash;
+	*hash = p;
+	p->count++;
+	nr_cache_pages++;
+}
+
+/*
+ * Take a page out of the cache. The cache's reference becomes the
+ * caller's, who has to free_page() it.
+ */
+static void remove_from_page_cache(struct page *p)
+{
+	struct page **pp = page_hash_table + page_hashfn(p->inode, p->offset);
+
+	for (; *pp; pp = &(*pp)->next_hash)
+		if (*pp == p) {
+			*pp = p->next_hash;
+			break;
+		}
+	p->inode = NULL;
+	p->next_hash = NULL;
+	p->flags &= ~PG_dirty;
+	nr_cache_pages--;
+}
+
+/*
+ * Write the page at 'page' back to the file, which it was mapped from at
+ * 'offset'. The file doesn't grow: blocks past the end are left alone.
+ */
+void write_page(struct m_inode *inode, unsigned long page,
+		unsigned long offset)
+{
+	struct buffer_head *bh;
+	int i, block;
+
+	for (i = 0; i < PAGE_SIZE / BLOCK_SIZE; i++, offset += BLOCK_SIZE) {
+		if (offset >= inode->i_size)
+			break;
+		if (!(block = create_block(inode, offset / BLOCK_SIZE)))
+			break;
+		if (!(bh = bread(inode->i_dev, block)))
+			break;
+		__asm__("cld ; rep ; movsl"
+			::"S" (page + i * BLOCK_SIZE), "D" (bh->b_data),
+			"c" (BLOCK_SIZE / 4));
+		bh->b_dirt = 1;
+		brelse(bh);
+	}
+	inode->i_mtime = CURRENT_TIME;
+	inode->i_dirt = 1;
+}
+
+/*
+ * Write a PG_dirty page to the buffer cache. We hold a reference while
+ * we sleep, so that nobody frees it under us.
+ */
+static void sync_page(struct page *p)
+{
+	p->count++;
+	p->flags &= ~PG_dirty;
+	write_page(p->inode, page_address(p), p->offset);
+	free_page(page_address(p));
+}
+
+/*
+ * Get the page at 'offset' of 'inode', reading it in if it isn't cached
+ * yet, with a reference for the caller. Returns 0 if out of memory.
+ */
+unsigned long get_cache_page(struct m_inode *inode, unsigned long offset)
+{
+	unsigned long page, new_page;
+	int nr[4], i;
+
+	if ((page = find_page(inode, offset)) != 0)
+		return get_page_ref(page) ? page : 0;
+	if (!(new_page = get_free_page()))
+		return 0;
+	for (i = 0; i < 4; i++)
+		nr[i] = bmap(inode, offset / BLOCK_SIZE + i);
+	bread_page(new_page, inode->i_dev, nr);
+	if (offset + PAGE_SIZE > inode->i_size) {	/* clear past EOF */
+		i = (offset < inode->i_size) ? inode->i_size - offset : 0;
+		memset((char *)new_page + i, 0, PAGE_SIZE - i);
+	}
+/* we slept: somebody may have read it in meanwhile */
+	if ((page = find_page(inode, offset)) != 0) {
+		free_page(new_page);
+		return get_page_ref(page) ? page : 0;
+	}
+	add_to_page_cache(new_page, inode, offset);
+	return new_page;
+}
+
+/*
+ * Drop the cached pages of 'inode'. iput() calls this with 'sync' set
+ * when the last user goes away: nobody maps the file then, and dirty
+ * pages are written back first. truncate() calls it without: the data
+ * is gone, and pages that are still mapped are cleared and left to
+ * their mappers. Returns 1 if it may have slept.
+ */
+int invalidate_inode_pages(struct m_inode *inode, int sync)
+{
+	struct page *p;
+	int i, slept = 0;
+
+	if (!nr_cache_pages)
+		return 0;
+	for (i = 0; i < PAGE_HASH_SIZE; i++) {
+repeat:
+		for (p = page_hash_table[i]; p; p = p->next_hash) {
+			if (p->inode != inode)
+				continue;
+			if (sync && (p->flags & PG_dirty)) {
+				sync_page(p);
+				slept = 1;
+				goto repeat;
+			}
+			if (!sync && p->count > 1)
+				memset((char *)page_address(p), 0, PAGE_SIZE);
+			remove_from_page_cache(p);
+			free_page(page_address(p));
+			goto repeat;
+		}
+	}
+	return slept;
+}
+
+/*
+ * Free a cached page that nobody maps, going round the hash table like
+ * a clock. Returns 1 if a page was freed.
+ */
+int shrink_page_cache(void)
+{
+	static int clock = 0;
+	struct page *p;
+	int n;
+
+	if (!nr_cache_pages)
+		return 0;
+	for (n = 0; n < PAGE_HASH_SIZE; n++) {
+repeat:
+		for (p = page_hash_table[clock]; p; p = p->next_hash) {
+			if (p->count != 1)
+				continue;
+			if (p->flags & PG_dirty) {
+				sync_page(p);
+				goto repeat;
+			}
+			remove_from_page_cache(p);
+			free_page(page_address(p));
+			return 1;
+		}
+		clock = (clock + 1) & (PAGE_HASH_SIZE - 1);
+	}
+	return 0;
+}
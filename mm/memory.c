@@ -28,71 +28,75 @@
  * 20.12.91  -  Ok, making the swap-device changeable like the root.
  */
 
+#include <errno.h>
 #include <signal.h>
+#include <sys/mman.h>
 
 #include <asm/system.h>
 
+#include <linux/config.h>
 #include <linux/sched.h>
 #include <linux/head.h>
 #include <linux/kernel.h>
+#include <linux/slab.h>
 
 #define CODE_SPACE(addr) ((((addr)+4095)&~4095) < \
 current->start_code + current->end_code)
 
 unsigned long HIGH_MEMORY = 0;
+int has_invlpg = 0;
+int fault_around_pages = FAULT_AROUND;
 
 #define copy_page(from,to) \
 __asm__("cld ; rep ; movsl"::"S" (from),"D" (to),"c" (1024):)
 
-unsigned char mem_map[PAGING_PAGES] = { 0, };
+struct page *mem_map = NULL;
+int paging_pages = 0;
 
 /*
- * Free a page of memory at physical address 'addr'. Used by
- * 'free_page_tables()'
+ * Drop the page and swap references held by the entries of a page
+ * table that is going away.
  */
-void free_page(unsigned long addr)
+static void free_table_entries(unsigned long *pg_table)
 {
-	if (addr < LOW_MEM)
-		return;
-	if (addr >= HIGH_MEMORY)
-		panic("trying to free nonexistent page");
-	addr -= LOW_MEM;
-	addr >>= 12;
-	if (mem_map[addr]--)
-		return;
-	mem_map[addr] = 0;
-	panic("trying to free free page");
+	int nr;
+
+	for (nr = 0; nr < 1024; nr++, pg_table++) {
+		if (!*pg_table)
+			continue;
+		if (1 & *pg_table)
+			free_page(0xfffff000 & *pg_table);
+		else
+			swap_free(*pg_table >> 1);
+		*pg_table = 0;
+	}
 }
 
 /*
- * This function frees a continuos block of page tables, as needed
- * by 'exit()'. As does copy_page_tables(), this handles only 4Mb blocks.
+ * This function frees a continuos block of page tables of the current
+ * task, as needed by 'exit()'. This handles only 4Mb blocks.
  */
 int free_page_tables(unsigned long from, unsigned long size)
 {
 	unsigned long *pg_table;
-	unsigned long *dir, nr;
+	unsigned long *dir;
 
 	if (from & 0x3fffff)
 		panic("free_page_tables called with wrong alignment");
 	if (!from)
 		panic("Trying to free up swapper memory space");
 	size = (size + 0x3fffff) >> 22;
-	dir = (unsigned long *)((from >> 20) & 0xffc);	/* _pg_dir = 0 */
+	dir = PAGE_DIR_OFFSET(current, from);
 	for (; size-- > 0; dir++) {
 		if (!(1 & *dir))
 			continue;
 		pg_table = (unsigned long *)(0xfffff000 & *dir);
-		for (nr = 0; nr < 1024; nr++) {
-			if (*pg_table) {
-				if (1 & *pg_table)
-					free_page(0xfffff000 & *pg_table);
-				else
-					swap_free(*pg_table >> 1);
-				*pg_table = 0;
-			}
-			pg_table++;
+		if (mem_map[MAP_NR((unsigned long)pg_table)].count > 1) {
+			free_page((unsigned long)pg_table);
+			*dir = 0;
+			continue;
 		}
+		free_table_entries(pg_table);
 		free_page(0xfffff000 & *dir);
 		*dir = 0;
 	}
@@ -101,91 +105,176 @@ int free_page_tables(unsigned long from, unsigned long size)
 }
 
 /*
- *  Well, here is one of the most complicated functions in mm. It
- * copies a range of linerar addresses by copying only the pages.
- * Let's hope this is bug-free, 'cause this one I don't want to debug :-)
- *
- * Note! We don't copy just any chunks of memory - addresses have to
- * be divisible by 4Mb (one page-directory entry), as this makes the
- * function easier. It's used only by fork anyway.
+ * Get a new page directory. The kernel part is the same for everybody,
+ * user space is empty.
+ */
+unsigned long new_page_dir(void)
+{
+	unsigned long *dir;
+	int i;
+
+	if (!(dir = (unsigned long *)get_free_page()))
+		return 0;
+	for (i = 0; i < (TASK_SIZE >> 22); i++)
+		dir[i] = pg_dir[i];
+	return (unsigned long)dir;
+}
+
+/*
+ * copy_page_tables() gives the child of a fork() a page directory of
+ * its own, with the same user space as the current task. We don't copy
+ * anything: the page tables themselves are shared copy-on-write. Both
+ * directory entries point at the same page table with PAGE_RW cleared,
+ * which write-protects the whole 4Mb, and the page table gets an extra
+ * count in mem_map. unshare_page_table() gives a task its own copy when
+ * it first writes, or changes a page table entry.
  *
- * NOTE 2!! When from==0 we are copying kernel space for the first
- * fork(). Then we DONT want to copy a full page-directory entry, as
- * that would lead to some serious memory waste - we just copy the
- * first 160 pages - 640kB. Even that is more than we need, but it
- * doesn't take any more memory - we don't copy-on-write in the low
- * 1 Mb-range, so the pages can be shared with the kernel. Thus the
- * special case for nr=xxxx.
+ * NOTE!! When the current task is task 0 (data base 0) we are copying
+ * kernel space for the first fork(). Then we DONT want to share a full
+ * page-directory entry, as that would lead to some serious memory waste
+ * - we just copy the first 160 pages - 640kB. Even that is more than we
+ * need, but it doesn't take any more memory - we don't copy-on-write in
+ * the low 1 Mb-range, so the pages can be shared with the kernel.
  */
-int copy_page_tables(unsigned long from, unsigned long to, long size)
+int copy_page_tables(struct task_struct *tsk)
 {
 	unsigned long *from_page_table;
 	unsigned long *to_page_table;
 	unsigned long this_page;
 	unsigned long *from_dir, *to_dir;
-	unsigned long new_page;
 	unsigned long nr;
 
-	if ((from & 0x3fffff) || (to & 0x3fffff))
-		panic("copy_page_tables called with wrong alignment");
-	from_dir = (unsigned long *)((from >> 20) & 0xffc);	/* _pg_dir = 0 */
-	to_dir = (unsigned long *)((to >> 20) & 0xffc);
-	size = ((unsigned)(size + 0x3fffff)) >> 22;
-	for (; size-- > 0; from_dir++, to_dir++) {
-		if (1 & *to_dir)
-			panic("copy_page_tables: already exist");
-		if (!(1 & *from_dir))
-			continue;
-		from_page_table = (unsigned long *)(0xfffff000 & *from_dir);
-		if (!(to_page_table = (unsigned long *)get_free_page()))
-			return -1;	/* Out of memory, see freeing */
+	if (!(tsk->tss.cr3 = new_page_dir()))
+		return -1;
+	to_dir = PAGE_DIR_OFFSET(tsk, TASK_SIZE);
+	if (!get_base(current->ldt[2])) {
+		from_page_table = (unsigned long *)(0xfffff000 & pg_dir[0]);
+		if (!(to_page_table = (unsigned long *)get_free_page())) {
+			free_page(tsk->tss.cr3);
+			return -1;
+		}
 		*to_dir = ((unsigned long)to_page_table) | 7;
-		nr = (from == 0) ? 0xA0 : 1024;
-		for (; nr-- > 0; from_page_table++, to_page_table++) {
+		for (nr = 0xA0; nr-- > 0; from_page_table++, to_page_table++) {
 			this_page = *from_page_table;
-			if (!this_page)
+			if (!(1 & this_page))
 				continue;
-			if (!(1 & this_page)) {
-				if (!(new_page = get_free_page()))
-					return -1;
-				++current->rss;
-				read_swap_page(this_page >> 1,
-					       (char *)new_page);
-				*to_page_table = this_page;
-				*from_page_table = new_page | (PAGE_DIRTY | 7);
+			*to_page_table = this_page & ~PAGE_RW;
+		}
+		return 0;
+	}
+	from_dir = PAGE_DIR_OFFSET(current, TASK_SIZE);
+	for (nr = TASK_SIZE >> 22; nr-- > 0; from_dir++, to_dir++) {
+		if (!(1 & *from_dir))
+			continue;
+		*from_dir &= ~PAGE_RW;
+		*to_dir = *from_dir;
+		if (!get_page_ref(0xfffff000 & *from_dir))
+			panic("copy_page_tables: page count overflow");
+	}
+	invalidate();
+	return 0;
+}
+
+/*
+ * Give the current task a private copy of the write-protected page table
+ * that 'dir' points at. Present pages are write-protected in both copies
+ * and get an extra reference, so the pages themselves stay copy-on-write;
+ * swapped-out pages get an extra swap reference. If we are the last user
+ * of the table we can just make it writable again. Returns 0 if out of
+ * memory.
+ *
+ * Reading a page in (when its swap count is full) sleeps, and the other
+ * users may exit or unshare meanwhile. The half-made copy is thrown away
+ * then, and we start over: we may be the last user by now.
+ */
+#define table_moved(dir, table) (!(1 & *(dir)) || (PAGE_RW & *(dir)) || \
+	(0xfffff000 & *(dir)) != (table) || \
+	mem_map[MAP_NR(table)].count == 1)
+
+static int unshare_page_table(unsigned long *dir)
+{
+	unsigned long old_table, new_table, entry;
+	unsigned long *from, *to;
+	int nr;
+
+repeat:
+	if (!(1 & *dir) || (PAGE_RW & *dir))
+		return 1;
+	old_table = 0xfffff000 & *dir;
+	if (mem_map[MAP_NR(old_table)].count == 1) {
+		*dir |= PAGE_RW;
+		invalidate();
+		return 1;
+	}
+	if (!(new_table = get_free_page()))
+		return 0;
+/* get_free_page() may have slept */
+	if (table_moved(dir, old_table)) {
+		free_page(new_table);
+		goto repeat;
+	}
+	from = (unsigned long *)old_table;
+	to = (unsigned long *)new_table;
+	for (nr = 0; nr < 1024; nr++) {
+		entry = from[nr];
+		if (!entry)
+			continue;
+		if (!(1 & entry)) {
+			if (swap_duplicate(entry >> 1)) {
+				to[nr] = entry;
 				continue;
 			}
-			this_page &= ~2;
-			*to_page_table = this_page;
-			if (this_page > LOW_MEM) {
-				*from_page_table = this_page;
-				this_page -= LOW_MEM;
-				this_page >>= 12;
-				mem_map[this_page]++;
+			swap_in(from + nr);
+			if (table_moved(dir, old_table)) {
+				free_table_entries(to);
+				free_page(new_table);
+				goto repeat;
 			}
+			nr--;		/* look at it again */
+			continue;
+		}
+		entry &= ~PAGE_RW;
+		from[nr] = entry;
+		to[nr] = entry;
+/* a page mmap()ed many times over can run out of references */
+		if (entry >= LOW_MEM && !get_page_ref(entry)) {
+			to[nr] = 0;
+			free_table_entries(to);
+			free_page(new_table);
+			return 0;
 		}
 	}
+	*dir = new_table | 7;
+	free_page(old_table);
 	invalidate();
-	return 0;
+	return 1;
 }
 
 /*
- * This function puts a page in memory at the wanted address.
- * It returns the physical address of the page gotten, 0 if
- * out of memory (either when trying to access page-table or
- * page.)
+ * Make sure the page table for 'address' (if there is one) belongs to the
+ * current task alone, so that its entries may be changed.
  */
-static unsigned long put_page(unsigned long page, unsigned long address)
+static void get_private_table(unsigned long address)
 {
-	unsigned long tmp, *page_table;
+	unsigned long *dir = PAGE_DIR_OFFSET(current, address);
 
-/* NOTE !!! This uses the fact that _pg_dir=0 */
+	if ((*dir & (PAGE_PRESENT | PAGE_RW)) == PAGE_PRESENT &&
+	    !unshare_page_table(dir))
+		oom();
+}
 
-	if (page < LOW_MEM || page >= HIGH_MEMORY)
-		printk("Trying to put page %p at %p\n", page, address);
-	if (mem_map[(page - LOW_MEM) >> 12] != 1)
-		printk("mem_map disagrees with %p at %p\n", page, address);
-	page_table = (unsigned long *)((address >> 20) & 0xffc);
+/*
+ * put_page() without its sanity checks, for pages that other tasks (or
+ * the page cache) may have references to as well.
+ */
+static unsigned long set_page_entry(unsigned long page, unsigned long address,
+				    unsigned long prot)
+{
+	unsigned long tmp, *page_table;
+
+	page_table = PAGE_DIR_OFFSET(current, address);
+	if ((*page_table & 3) == 1 && !unshare_page_table(page_table))
+		return 0;
 	if ((*page_table) & 1)
 		page_table = (unsigned long *)(0xfffff000 & *page_table);
 	else {
@@ -194,11 +283,27 @@ static unsigned long put_page(unsigned long page, unsigned long address)
 		*page_table = tmp | 7;
 		page_table = (unsigned long *)tmp;
 	}
-	page_table[(address >> 12) & 0x3ff] = page | 7;
+	page_table[(address >> 12) & 0x3ff] = page | prot;
 /* no need for invalidate */
 	return page;
 }
 
+/*
+ * This function puts a page in memory at the wanted address, with
+ * the page table flags 'prot'. It returns the physical address of
+ * the page gotten, 0 if out of memory (either when trying to access
+ * page-table or page.)
+ */
+static unsigned long put_page(unsigned long page, unsigned long address,
+			      unsigned long prot)
+{
+	if (page < LOW_MEM || page >= HIGH_MEMORY)
+		printk("Trying to put page %p at %p\n", page, address);
+	if (mem_map[MAP_NR(page)].count != 1)
+		printk("mem_map disagrees with %p at %p\n", page, address);
+	return set_page_entry(page, address, prot);
+}
+
 /*
  * The previous function doesn't work very well if you also want to mark
  * the page dirty: exec.c wants this, as it has earlier changed the page,
@@ -209,13 +314,13 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 {
 	unsigned long tmp, *page_table;
 
-/* NOTE !!! This uses the fact that _pg_dir=0 */
-
 	if (page < LOW_MEM || page >= HIGH_MEMORY)
 		printk("Trying to put page %p at %p\n", page, address);
-	if (mem_map[(page - LOW_MEM) >> 12] != 1)
+	if (mem_map[MAP_NR(page)].count != 1)
 		printk("mem_map disagrees with %p at %p\n", page, address);
-	page_table = (unsigned long *)((address >> 20) & 0xffc);
+	page_table = PAGE_DIR_OFFSET(current, address);
+	if ((*page_table & 3) == 1 && !unshare_page_table(page_table))
+		return 0;
 	if ((*page_table) & 1)
 		page_table = (unsigned long *)(0xfffff000 & *page_table);
 	else {
@@ -229,23 +334,61 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 	return page;
 }
 
-void un_wp_page(unsigned long *table_entry)
+/*
+ * Flush the TLB after changing the entry for 'address' of task 'p'.
+ * Only the current page directory can be in the TLB. If the page table
+ * is shared after a fork(), it may be in there even if 'p' isn't us.
+ */
+void flush_task_page(unsigned long *table_entry, struct task_struct *p,
+		     unsigned long address)
+{
+	if (mem_map[MAP_NR(0xfffff000 & (unsigned long)table_entry)].count > 1)
+		invalidate();
+	else if (p->tss.cr3 == current->tss.cr3)
+		invalidate_page(address);
+}
+
+void un_wp_page(unsigned long *table_entry, unsigned long address)
 {
 	unsigned long old_page, new_page;
 
 	old_page = 0xfffff000 & *table_entry;
-	if (old_page >= LOW_MEM && mem_map[MAP_NR(old_page)] == 1) {
+	if (old_page >= LOW_MEM && mem_map[MAP_NR(old_page)].count == 1) {
 		*table_entry |= 2;
-		invalidate();
+		invalidate_page(address);
 		return;
 	}
 	if (!(new_page = get_free_page()))
 		oom();
 	if (old_page >= LOW_MEM)
-		mem_map[MAP_NR(old_page)]--;
-	copy_page(old_page, new_page);
+		mem_map[MAP_NR(old_page)].count--;
+	if (old_page != ZERO_PAGE)	/* get_free_page() already cleared it */
+		copy_page(old_page, new_page);
+	else
+		++current->rss;
 	*table_entry = new_page | 7;
-	invalidate();
+	invalidate_page(address);
+}
+
+/*
+ * Make a write-protected entry writable. The pages of shared file
+ * mappings are meant to be shared, so they just get PAGE_RW back (they
+ * are write-protected after a fork()); anything else is copied.
+ */
+static void make_pte_writable(unsigned long *table_entry,
+			      unsigned long address)
+{
+	struct vm_area_struct *vma;
+
+	vma = find_vma(current, address - current->start_code);
+	if (vma && vma->vm_inode && (vma->vm_flags & MAP_SHARED) &&
+	    (0xfffff000 & *table_entry) >= LOW_MEM &&
+	    mem_map[MAP_NR(0xfffff000 & *table_entry)].inode) {
+		*table_entry |= PAGE_RW;
+		invalidate_page(address);
+		return;
+	}
+	un_wp_page(table_entry, address);
 }
 
 /*
@@ -257,6 +400,8 @@ void un_wp_page(unsigned long *table_entry)
  */
 void do_wp_page(unsigned long error_code, unsigned long address)
 {
+	struct vm_area_struct *vma;
+
 	if (address < TASK_SIZE)
 		printk("\n\rBAD! KERNEL MEMORY WP-ERR!\n\r");
 	if (address - current->start_code > TASK_SIZE) {
@@ -269,12 +414,17 @@ void do_wp_page(unsigned long error_code, unsigned long address)
 	if (CODE_SPACE(address))
 		do_exit(SIGSEGV);
 #endif
+	vma = find_vma(current, address - current->start_code);
+	if (vma && !(vma->vm_prot & PROT_WRITE))
+		do_exit(SIGSEGV);
 	++current->min_flt;
-	un_wp_page((unsigned long *)
-		   (((address >> 10) & 0xffc) + (0xfffff000 &
-						 *((unsigned long
-						    *)((address >> 20) &
-						       0xffc)))));
+	count_fault(current);
+	get_private_table(address);
+	make_pte_writable((unsigned long *)
+			  (((address >> 10) & 0xffc) + (0xfffff000 &
+							*PAGE_DIR_OFFSET(current,
+									 address))),
+			  address);
 
 }
 
@@ -282,25 +432,255 @@ void write_verify(unsigned long address)
 {
 	unsigned long page;
 
-	if (!((page = *((unsigned long *)((address >> 20) & 0xffc))) & 1))
+	if (!((page = *PAGE_DIR_OFFSET(current, address)) & 1))
 		return;
+	if (!(page & PAGE_RW)) {
+		get_private_table(address);
+		page = *PAGE_DIR_OFFSET(current, address);
+	}
 	page &= 0xfffff000;
 	page += ((address >> 10) & 0xffc);
 	if ((3 & *(unsigned long *)page) == 1)	/* non-writeable, present */
-		un_wp_page((unsigned long *)page);
+		make_pte_writable((unsigned long *)page, address);
 	return;
 }
 
+/*
+ * Map the zero page read-only at 'address'. The first write to it goes
+ * through do_wp_page(), which gives the task a private page then. The
+ * zero page is nobody's and can't be swapped out, so it isn't counted
+ * in rss until then.
+ */
+static void get_zero_page(unsigned long address)
+{
+	unsigned long tmp, *page_table;
+
+	page_table = PAGE_DIR_OFFSET(current, address);
+	if (!(*page_table & 1)) {
+		if (!(tmp = get_free_page()))
+			oom();
+		*page_table = tmp | 7;
+	}
+	page_table = (unsigned long *)(0xfffff000 & *page_table);
+	page_table[(address >> 12) & 0x3ff] = ZERO_PAGE | PAGE_USER | PAGE_PRESENT;
+	if (current->rss)	/* do_no_page() counted it */
+		--current->rss;
+/* no need for invalidate */
+}
+
 void get_empty_page(unsigned long address)
 {
 	unsigned long tmp;
 
-	if (!(tmp = get_free_page()) || !put_page(tmp, address)) {
+	if (!(tmp = get_free_page()) || !put_page(tmp, address, 7)) {
 		free_page(tmp);	/* 0 is ok - ignored */
 		oom();
 	}
 }
 
+/*
+ * Unmap the pages between the linear addresses 'from' and 'from+size'
+ * of the current task. Unlike free_page_tables() this needn't be on
+ * 4Mb boundaries, and the page tables stay.
+ */
+void unmap_page_range(unsigned long from, unsigned long size)
+{
+	unsigned long *dir, *pte;
+	unsigned long n;
+
+	while (size > 0) {
+		dir = PAGE_DIR_OFFSET(current, from);
+		if (!(1 & *dir)) {
+			n = 0x400000 - (from & 0x3fffff);
+			if (n >= size)
+				break;
+			from += n;
+			size -= n;
+			continue;
+		}
+		get_private_table(from);
+		pte = (unsigned long *)(0xfffff000 & *dir) + ((from >> 12) & 0x3ff);
+		if (1 & *pte) {
+			free_page(0xfffff000 & *pte);
+			if ((0xfffff000 & *pte) != ZERO_PAGE && current->rss)
+				--current->rss;
+		} else if (*pte)
+			swap_free(*pte >> 1);
+		*pte = 0;
+		from += PAGE_SIZE;
+		size = (size > PAGE_SIZE) ? size - PAGE_SIZE : 0;
+	}
+	invalidate();
+}
+
+/*
+ * A page fault in a mmap()ed area. Anonymous areas get zero pages like
+ * the bss. Shared file mappings map the page cache page, so that all
+ * mappers see the same page; private ones get a copy read in through
+ * the buffer cache. Pages of areas that mayn't be written are mapped
+ * read-only, so that a write ends up in do_wp_page(), which refuses it.
+ * PROT_NONE areas aren't mapped at all.
+ */
+static void do_mmap_page(struct vm_area_struct *vma, unsigned long error_code,
+			 unsigned long address, unsigned long tmp)
+{
+	struct m_inode *inode = vma->vm_inode;
+	unsigned long page, offset, prot;
+	int nr[4], i;
+
+	if (!(vma->vm_prot & (PROT_READ | PROT_WRITE | PROT_EXEC)))
+		do_exit(SIGSEGV);
+	prot = (vma->vm_prot & PROT_WRITE) ? 7 : 5;
+	if ((error_code & 2) && !(prot & PAGE_RW))
+		do_exit(SIGSEGV);
+	if (!inode) {
+		++current->min_flt;
+		if (error_code & 2)
+			get_empty_page(address);
+		else
+			get_zero_page(address);
+		return;
+	}
+	offset = vma->vm_offset + (tmp - vma->vm_start);
+	if (vma->vm_flags & MAP_SHARED) {
+		if (find_page(inode, offset))
+			++current->min_flt;
+		else
+			++current->maj_flt;
+		if (!(page = get_cache_page(inode, offset)))
+			oom();
+		if (set_page_entry(page, address, prot))
+			return;
+		free_page(page);
+		oom();
+	}
+	++current->maj_flt;
+	if (!(page = get_free_page()))
+		oom();
+	for (i = 0; i < 4; i++)
+		nr[i] = bmap(inode, offset / BLOCK_SIZE + i);
+	bread_page(page, inode->i_dev, nr);
+	if (offset + PAGE_SIZE > inode->i_size) {	/* clear past EOF */
+		i = (offset < inode->i_size) ? inode->i_size - offset : 0;
+		for (; i < PAGE_SIZE; i++)
+			((char *)page)[i] = 0;
+	}
+	if (put_page(page, address, prot))
+		return;
+	free_page(page);
+	oom();
+}
+
+/*
+ * The part of a page of the executable past end_data is bss: clear it.
+ */
+static void clear_past_data(unsigned long page, unsigned long tmp)
+{
+	int i;
+
+	i = tmp + 4096 - current->end_data;
+	if (i > 4095)
+		i = 0;
+	page += 4096;
+	while (i-- > 0) {
+		page--;
+		*(char *)page = 0;
+	}
+}
+
+/*
+ * Fault-around: having read in the page at 'address' (offset 'tmp') of
+ * the executable or library 'inode', map the other pages of the aligned
+ * fault_around_pages window too, if all their blocks are in the buffer
+ * cache already. That is cheap - no I/O - and saves a fault for each of
+ * them when a program runs through its text. They go in read-only and
+ * clean, so they can still be shared and thrown away.
+ *
+ * We don't swap to get pages for this, and get_hash_table()/bmap() may
+ * sleep, so the page table entry is checked again before we use it.
+ */
+static void fault_around(struct m_inode *inode, unsigned long address,
+			 unsigned long tmp)
+{
+	struct buffer_head *bh[4];
+	unsigned long addr, end, page, *pte;
+	int n = fault_around_pages, lib, nr, block, i, cached;
+
+	if (n <= 1 || n > 1024)
+		return;
+	lib = tmp >= LIBRARY_OFFSET;
+	addr = address - ((tmp >> 12) % n) * PAGE_SIZE;
+	end = addr + n * PAGE_SIZE;
+	for (; addr < end; addr += PAGE_SIZE) {
+		if (addr == address || ((addr ^ address) & 0xffc00000))
+			continue;
+		tmp = addr - current->start_code;
+		if (lib) {
+			if (tmp < LIBRARY_OFFSET)
+				continue;
+			block = 1 + (tmp - LIBRARY_OFFSET) / BLOCK_SIZE;
+		} else {
+			if (tmp >= current->end_data)
+				continue;
+			block = 1 + tmp / BLOCK_SIZE;
+		}
+		pte = (unsigned long *)(0xfffff000 &
+					*PAGE_DIR_OFFSET(current, addr)) +
+		    ((addr >> 12) & 0x3ff);
+		if (*pte)
+			continue;
+		bh[0] = bh[1] = bh[2] = bh[3] = NULL;
+		cached = 0;
+		for (i = 0; i < 4; i++) {
+			if (!(nr = bmap(inode, block + i)))
+				continue;
+			if (!(bh[i] = get_hash_table(inode->i_dev, nr)) ||
+			    !bh[i]->b_uptodate)
+				break;
+			cached++;
+		}
+		if (i < 4 || !cached || *pte ||
+		    !(page = __get_free_pages(0))) {
+			for (i = 0; i < 4; i++)
+				brelse(bh[i]);
+			continue;
+		}
+		for (i = 0; i < 4; i++) {
+			if (bh[i]) {
+				__asm__("cld ; rep ; movsl"
+					::"S" (bh[i]->b_data),
+					"D" (page + i * BLOCK_SIZE),
+					"c" (BLOCK_SIZE / 4));
+				brelse(bh[i]);
+			} else
+				__asm__("cld ; rep ; stosl"
+					::"a" (0), "D" (page + i * BLOCK_SIZE),
+					"c" (BLOCK_SIZE / 4));
+		}
+		clear_past_data(page, tmp);
+		*pte = page | 5;
+		++current->rss;
+	}
+}
+
+/*
+ * Get the fault-around window, and set it if 'pages' isn't 0 (only the
+ * superuser may). Returns the old size.
+ */
+int sys_fault_around(int pages)
+{
+	int old = fault_around_pages;
+
+	if (!pages)
+		return old;
+	if (!suser())
+		return -EPERM;
+	if (pages < 0 || pages > 1024)
+		return -EINVAL;
+	fault_around_pages = pages;
+	return old;
+}
+
 /*
  * try_to_share() checks the page at address "address" in the task "p",
  * to see if it exists, and if it is clean. If so, share it with the current
@@ -316,9 +696,9 @@ static int try_to_share(unsigned long address, struct task_struct *p)
 	unsigned long to_page;
 	unsigned long phys_addr;
 
-	from_page = to_page = ((address >> 20) & 0xffc);
-	from_page += ((p->start_code >> 20) & 0xffc);
-	to_page += ((current->start_code >> 20) & 0xffc);
+	from_page = (unsigned long)PAGE_DIR_OFFSET(p, p->start_code + address);
+	to_page = (unsigned long)PAGE_DIR_OFFSET(current,
+						 current->start_code + address);
 /* is there a page-directory at from? */
 	from = *(unsigned long *)from_page;
 	if (!(from & 1))
@@ -332,6 +712,11 @@ static int try_to_share(unsigned long address, struct task_struct *p)
 	phys_addr &= 0xfffff000;
 	if (phys_addr >= HIGH_MEMORY || phys_addr < LOW_MEM)
 		return 0;
+	if (mem_map[MAP_NR(phys_addr)].count >= MAX_PAGE_COUNT)
+		return 0;
+	if ((*(unsigned long *)to_page & 3) == 1 &&
+	    !unshare_page_table((unsigned long *)to_page))
+		oom();
 	to = *(unsigned long *)to_page;
 	if (!(to & 1))
 		if (to = get_free_page())
@@ -345,10 +730,9 @@ static int try_to_share(unsigned long address, struct task_struct *p)
 /* share them: write-protect */
 	*(unsigned long *)from_page &= ~2;
 	*(unsigned long *)to_page = *(unsigned long *)from_page;
-	invalidate();
-	phys_addr -= LOW_MEM;
-	phys_addr >>= 12;
-	mem_map[phys_addr]++;
+	flush_task_page((unsigned long *)from_page, p,
+			p->start_code + address);
+	mem_map[MAP_NR(phys_addr)].count++;
 	return 1;
 }
 
@@ -362,36 +746,91 @@ static int try_to_share(unsigned long address, struct task_struct *p)
  */
 static int share_page(struct m_inode *inode, unsigned long address)
 {
-	struct task_struct **p;
+	struct task_struct *p;
+	int which;
 
-	if (inode->i_count < 2 || !inode)
+	if (!inode || inode->i_count < 2)
 		return 0;
-	for (p = &LAST_TASK; p > &FIRST_TASK; --p) {
-		if (!*p)
+	which = (address < LIBRARY_OFFSET) ? I_MAP_EXEC : I_MAP_LIB;
+	for (p = inode->i_mapped[which]; p; p = p->map_next[which]) {
+		if (p == current)
 			continue;
-		if (current == *p)
-			continue;
-		if (address < LIBRARY_OFFSET) {
-			if (inode != (*p)->executable)
-				continue;
-		} else {
-			if (inode != (*p)->library)
-				continue;
-		}
-		if (try_to_share(address, *p))
+		if (try_to_share(address, p))
 			return 1;
 	}
 	return 0;
 }
 
+/*
+ * Every inode keeps a list of the tasks that have it as their executable
+ * or library, so that share_page() goes straight to the tasks that can
+ * share a page with us instead of looking through the whole task table.
+ */
+static void unlink_mapped(struct task_struct *p, int which,
+			  struct m_inode *inode)
+{
+	if (!inode)
+		return;
+	if (p->map_prev[which])
+		p->map_prev[which]->map_next[which] = p->map_next[which];
+	else
+		inode->i_mapped[which] = p->map_next[which];
+	if (p->map_next[which])
+		p->map_next[which]->map_prev[which] = p->map_prev[which];
+}
+
+static void link_mapped(struct task_struct *p, int which,
+			struct m_inode *inode)
+{
+	p->map_prev[which] = NULL;
+	p->map_next[which] = NULL;
+	if (!inode)
+		return;
+	if ((p->map_next[which] = inode->i_mapped[which]) != NULL)
+		p->map_next[which]->map_prev[which] = p;
+	inode->i_mapped[which] = p;
+}
+
+/*
+ * Change the executable/library of 'p' to 'inode', whose reference the
+ * caller hands over to us, and put the old one. The old one is unlinked
+ * first: iput() may sleep, and the inode may be reused meanwhile.
+ */
+void set_executable(struct task_struct *p, struct m_inode *inode)
+{
+	struct m_inode *old = p->executable;
+
+	unlink_mapped(p, I_MAP_EXEC, old);
+	p->executable = inode;
+	link_mapped(p, I_MAP_EXEC, inode);
+	iput(old);
+}
+
+void set_library(struct task_struct *p, struct m_inode *inode)
+{
+	struct m_inode *old = p->library;
+
+	unlink_mapped(p, I_MAP_LIB, old);
+	p->library = inode;
+	link_mapped(p, I_MAP_LIB, inode);
+	iput(old);
+}
+
+/*
+ * A task that hits its RSS limit gives up this many pages below it, so
+ * that it doesn't have to run the clock over itself on every fault.
+ */
+#define RSS_SLACK 8
+
 void do_no_page(unsigned long error_code, unsigned long address)
 {
 	int nr[4];
-	unsigned long tmp;
+	unsigned long tmp, limit;
 	unsigned long page;
 	int block, i;
 	struct m_inode *inode;
 	struct task_struct *tsk;
+	struct vm_area_struct *vma;
 
 	tsk = current;
 
@@ -402,8 +841,16 @@ void do_no_page(unsigned long error_code, unsigned long address)
 		    ("Bad things happen: nonexistent page error in do_no_page\n\r");
 		do_exit(SIGSEGV);
 	}
+	count_fault(tsk);
+/* over the RSS limit: give up some of our own pages for this one */
+	limit = tsk->rlim[RLIMIT_RSS].rlim_cur >> 12;
+	if (tsk->rss >= limit)
+		for (i = RSS_SLACK; i > 0 && tsk->rss + RSS_SLACK > limit; i--)
+			if (!swap_out_task(tsk, 1))
+				break;
 	++tsk->rss;
-	page = *(unsigned long *)((address >> 20) & 0xffc);
+	get_private_table(address);
+	page = *PAGE_DIR_OFFSET(current, address);
 	if (page & 1) {
 		page &= 0xfffff000;
 		page += (address >> 10) & 0xffc;
@@ -416,6 +863,10 @@ void do_no_page(unsigned long error_code, unsigned long address)
 	}
 	address &= 0xfffff000;
 	tmp = address - current->start_code;
+	if ((vma = find_vma(current, tmp)) != NULL) {
+		do_mmap_page(vma, error_code, address, tmp);
+		return;
+	}
 	if (tmp >= LIBRARY_OFFSET) {
 		inode = current->library;
 		block = 1 + (tmp - LIBRARY_OFFSET) / BLOCK_SIZE;
@@ -431,7 +882,10 @@ void do_no_page(unsigned long error_code, unsigned long address)
 		if (tmp > tsk->brk && tsk == current &&
 		    LIBRARY_OFFSET - tmp > tsk->rlim[RLIMIT_STACK].rlim_max)
 			do_exit(SIGSEGV);
-		get_empty_page(address);
+		if (error_code & 2)
+			get_empty_page(address);
+		else
+			get_zero_page(address);
 		return;
 	}
 	if (tsk == current)
@@ -446,63 +900,123 @@ void do_no_page(unsigned long error_code, unsigned long address)
 	for (i = 0; i < 4; block++, i++)
 		nr[i] = bmap(inode, block);
 	bread_page(page, inode->i_dev, nr);
-	i = tmp + 4096 - current->end_data;
-	if (i > 4095)
-		i = 0;
-	tmp = page + 4096;
-	while (i-- > 0) {
-		tmp--;
-		*(char *)tmp = 0;
-	}
-	if (put_page(page, address))
+	clear_past_data(page, tmp);
+	if (put_page(page, address, 7)) {
+		fault_around(inode, address, tmp);
 		return;
+	}
 	free_page(page);
 	oom();
 }
 
+/*
+ * A 486 can toggle the AC flag in eflags, a 386 can't. That's all we
+ * need to know to use 'invlpg'.
+ */
+static int check_486(void)
+{
+	unsigned long res;
+
+	__asm__("pushfl\n\t"
+		"popl %%eax\n\t"
+		"movl %%eax,%%ecx\n\t"
+		"xorl $0x40000,%%eax\n\t"
+		"pushl %%eax\n\t"
+		"popfl\n\t"
+		"pushfl\n\t"
+		"popl %%eax\n\t"
+		"xorl %%ecx,%%eax\n\t"
+		"pushl %%ecx\n\t"
+		"popfl"
+		:"=a" (res)::"cx");
+	return (res & 0x40000) != 0;
+}
+
+/*
+ * head.s only maps the first 16Mb. The page tables for the rest of
+ * physical memory are taken from start_mem (which is below 16Mb, so we
+ * can get at them), and go into the kernel's page directory.
+ */
+static unsigned long paging_init(unsigned long start_mem,
+				 unsigned long end_mem)
+{
+	unsigned long address, *pg_table;
+	int i;
+
+	start_mem = PAGE_ALIGN(start_mem);
+	for (address = 16 * 1024 * 1024; address < end_mem;
+	     address += 0x400000) {
+		pg_table = (unsigned long *)start_mem;
+		start_mem += PAGE_SIZE;
+		for (i = 0; i < 1024; i++)
+			if (address + (i << 12) < end_mem)
+				pg_table[i] = (address + (i << 12)) | 7;
+			else
+				pg_table[i] = 0;
+		pg_dir[address >> 22] = (unsigned long)pg_table | 7;
+	}
+	invalidate();
+	return start_mem;
+}
+
 void mem_init(long start_mem, long end_mem)
 {
 	int i;
 
+	has_invlpg = check_486();
 	HIGH_MEMORY = end_mem;
-	for (i = 0; i < PAGING_PAGES; i++)
-		mem_map[i] = USED;
-	i = MAP_NR(start_mem);
-	end_mem -= start_mem;
-	end_mem >>= 12;
-	while (end_mem-- > 0)
-		mem_map[i++] = 0;
+	start_mem = paging_init(start_mem, end_mem);
+	paging_pages = MAP_NR(end_mem);
+	mem_map = (struct page *)start_mem;
+	start_mem += paging_pages * sizeof(struct page);
+	for (i = 0; i < paging_pages; i++) {
+		mem_map[i].count = 1;
+		mem_map[i].flags = PG_reserved;
+		mem_map[i].private = 0;
+		mem_map[i].inode = NULL;
+		mem_map[i].next_hash = NULL;
+	}
+	free_area_init(start_mem, end_mem);
 }
 
 void show_mem(void)
 {
-	int i, j, k, free = 0, total = 0;
+	int i, j, k, n, free = 0, total = 0;
 	int shared = 0;
-	unsigned long *pg_tbl;
+	unsigned long *pg_tbl, *dir;
 
 	printk("Mem-info:\n\r");
-	for (i = 0; i < PAGING_PAGES; i++) {
-		if (mem_map[i] == USED)
+	for (i = 0; i < paging_pages; i++) {
+		if (mem_map[i].flags & PG_reserved)
 			continue;
 		total++;
-		if (!mem_map[i])
+		if (!mem_map[i].count)
 			free++;
 		else
-			shared += mem_map[i] - 1;
+			shared += mem_map[i].count - 1;
 	}
 	printk("%d free pages of %d\n\r", free, total);
+	show_free_areas();
 	printk("%d pages shared\n\r", shared);
-	k = 0;
-	for (i = 4; i < 1024;) {
-		if (1 & pg_dir[i]) {
-			if (pg_dir[i] > HIGH_MEMORY) {
+	printk("%d pages in the page cache\n\r", nr_cache_pages);
+	show_zswap();
+	show_slab();
+	for (n = 1; n < NR_TASKS; n++) {
+		if (!task[n])
+			continue;
+		dir = (unsigned long *)task[n]->tss.cr3;
+		k = 0;
+		for (i = TASK_SIZE >> 22; i < (TASK_SIZE >> 21); i++) {
+			if (!(1 & dir[i]))
+				continue;
+			if (dir[i] > HIGH_MEMORY) {
 				printk("page directory[%d]: %08X\n\r",
-				       i, pg_dir[i]);
+				       i, dir[i]);
 				continue;
 			}
-			if (pg_dir[i] > LOW_MEM)
+			if (dir[i] > LOW_MEM)
 				free++, k++;
-			pg_tbl = (unsigned long *)(0xfffff000 & pg_dir[i]);
+			pg_tbl = (unsigned long *)(0xfffff000 & dir[i]);
 			for (j = 0; j < 1024; j++)
 				if ((pg_tbl[j] & 1) && pg_tbl[j] > LOW_MEM)
 					if (pg_tbl[j] > HIGH_MEMORY)
@@ -512,12 +1026,10 @@ void show_mem(void)
 					else
 						k++, free++;
 		}
-		i++;
-		if (!(i & 15) && k) {
-			k++, free++;	/* one page/process for task_struct */
-			printk("Process %d: %d pages\n\r", (i >> 4) - 1, k);
-			k = 0;
-		}
+		if (dir != pg_dir)
+			k++, free++;	/* the page directory */
+		k++, free++;	/* one page/process for task_struct */
+		printk("Process %d: %d pages\n\r", n, k);
 	}
 	printk("Memory found: %d (%d)\n\r", free - shared, total);
 }
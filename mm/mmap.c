@@ -0,0 +1,292 @@
+/*
+ *  linux/mm/mmap.c
+ */
+
+/*
+ * mmap() and munmap(). A task's mappings are kept in a sorted list of
+ * vm_area_structs hanging off task->mmap. Nothing is mapped in when the
+ * area is set up: do_no_page() finds the area and brings the pages in
+ * from the file (through the buffer cache), or maps the zero page for
+ * anonymous memory.
+ *
+ * MAP_SHARED file mappings map the pages of the page cache (filemap.c),
+ * so every task mapping the file sees the same pages, and so do read()
+ * and write(). Pages written through a mapping go back to the file when
+ * they are unmapped (munmap, exit or exec), or when the cache lets them
+ * go.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <asm/segment.h>
+
+/*
+ * Mappings go between MMAP_BASE and the stack, leaving STACK_GAP for
+ * the stack to grow into.
+ */
+#define MMAP_BASE	(TASK_SIZE >> 1)
+#define STACK_GAP	0x4000000
+#define MMAP_LIMIT	(LIBRARY_OFFSET - STACK_GAP)
+
+struct vm_area_struct *find_vma(struct task_struct *tsk, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+
+	for (vma = tsk->mmap; vma; vma = vma->vm_next) {
+		if (addr < vma->vm_start)
+			return NULL;
+		if (addr < vma->vm_end)
+			return vma;
+	}
+	return NULL;
+}
+
+static unsigned long get_unmapped_area(unsigned long len)
+{
+	struct vm_area_struct *vma;
+	unsigned long addr = MMAP_BASE;
+
+	for (vma = current->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_end <= addr)
+			continue;
+		if (addr + len <= vma->vm_start)
+			break;
+		addr = vma->vm_end;
+	}
+	if (addr + len > MMAP_LIMIT)
+		return 0;
+	return addr;
+}
+
+/*
+ * Write back the pages between 'start' and 'end' of a shared mapping
+ * that have been written to. They are page cache pages, which the
+ * swapper never sends to swap: if it has taken one out of the page
+ * table it left PG_dirty set, and the cache writes it back later.
+ */
+static void write_back(struct vm_area_struct *vma, unsigned long start,
+		       unsigned long end)
+{
+	unsigned long address, pte, page;
+	unsigned long *dir;
+	struct page *p;
+
+	for (; start < end; start += PAGE_SIZE) {
+		address = current->start_code + start;
+		dir = PAGE_DIR_OFFSET(current, address);
+		if (!(1 & *dir))
+			continue;
+		pte = ((unsigned long *)(0xfffff000 & *dir))
+		    [(address >> 12) & 0x3ff];
+		if (!(1 & pte))
+			continue;
+		page = 0xfffff000 & pte;
+		if (page < LOW_MEM)
+			continue;
+		p = mem_map + MAP_NR(page);
+		if (p->inode != vma->vm_inode)
+			continue;
+		if (!(pte & PAGE_DIRTY) && !(p->flags & PG_dirty))
+			continue;
+		if (!get_page_ref(page))
+			continue;
+		p->flags &= ~PG_dirty;
+		write_page(p->inode, page, p->offset);
+		free_page(page);
+	}
+}
+
+static void free_vma(struct vm_area_struct *vma)
+{
+	iput(vma->vm_inode);
+	free_s(vma, sizeof(struct vm_area_struct));
+}
+
+int do_munmap(unsigned long addr, unsigned long len)
+{
+	struct vm_area_struct *vma, *new, **p;
+	unsigned long start, end;
+
+	if ((addr & 0xfff) || addr > TASK_SIZE || len > TASK_SIZE - addr)
+		return -EINVAL;
+	if (!(len = PAGE_ALIGN(len)))
+		return 0;
+	for (p = &current->mmap; (vma = *p) != NULL;) {
+		if (vma->vm_end <= addr) {
+			p = &vma->vm_next;
+			continue;
+		}
+		if (vma->vm_start >= addr + len)
+			break;
+		start = (addr > vma->vm_start) ? addr : vma->vm_start;
+		end = (addr + len < vma->vm_end) ? addr + len : vma->vm_end;
+		new = NULL;
+		if (start > vma->vm_start && end < vma->vm_end &&
+		    !(new = malloc(sizeof(struct vm_area_struct))))
+			return -ENOMEM;
+		if (vma->vm_inode && (vma->vm_flags & MAP_SHARED))
+			write_back(vma, start, end);
+		unmap_page_range(current->start_code + start, end - start);
+		if (new) {		/* a hole in the middle: split it */
+			*new = *vma;
+			new->vm_start = end;
+			new->vm_offset += end - vma->vm_start;
+			if (new->vm_inode)
+				new->vm_inode->i_count++;
+			vma->vm_end = start;
+			vma->vm_next = new;
+			p = &new->vm_next;
+		} else if (start > vma->vm_start) {
+			vma->vm_end = start;
+			p = &vma->vm_next;
+		} else if (end < vma->vm_end) {
+			vma->vm_offset += end - vma->vm_start;
+			vma->vm_start = end;
+			p = &vma->vm_next;
+		} else {
+			*p = vma->vm_next;
+			free_vma(vma);
+		}
+	}
+	return 0;
+}
+
+static int do_mmap(struct file *file, unsigned long addr, unsigned long len,
+		   int prot, int flags, unsigned long off)
+{
+	struct vm_area_struct *vma, **p;
+	struct m_inode *inode = NULL;
+	int error;
+
+	if (current->flags & PF_VFORK)	/* not our address space */
+		return -EINVAL;
+	if (!len || len > MMAP_LIMIT)
+		return -EINVAL;
+	len = PAGE_ALIGN(len);
+	if ((flags & MAP_TYPE) != MAP_SHARED &&
+	    (flags & MAP_TYPE) != MAP_PRIVATE)
+		return -EINVAL;
+	if (!(flags & MAP_ANONYMOUS)) {
+		if (!file || !(inode = file->f_inode))
+			return -EBADF;
+		if (!S_ISREG(inode->i_mode))
+			return -ENODEV;
+		if ((file->f_flags & O_ACCMODE) == O_WRONLY)
+			return -EACCES;
+		if ((flags & MAP_TYPE) == MAP_SHARED && (prot & PROT_WRITE) &&
+		    (file->f_flags & O_ACCMODE) != O_RDWR)
+			return -EACCES;
+		if (off & 0xfff)
+			return -EINVAL;
+	}
+	if (flags & MAP_FIXED) {
+		if ((addr & 0xfff) || addr < current->brk ||
+		    addr + len > MMAP_LIMIT)
+			return -EINVAL;
+		if ((error = do_munmap(addr, len)) != 0)
+			return error;
+	} else if (!(addr = get_unmapped_area(len)))
+		return -ENOMEM;
+	if (!(vma = malloc(sizeof(struct vm_area_struct))))
+		return -ENOMEM;
+	vma->vm_start = addr;
+	vma->vm_end = addr + len;
+	vma->vm_prot = prot;
+	vma->vm_flags = flags;
+	vma->vm_inode = inode;
+	vma->vm_offset = off;
+	if (inode)
+		inode->i_count++;
+	for (p = &current->mmap; *p; p = &(*p)->vm_next)
+		if ((*p)->vm_start >= addr)
+			break;
+	vma->vm_next = *p;
+	*p = vma;
+	return addr;
+}
+
+/*
+ * mmap() takes six arguments, more than fit in registers, so the user
+ * passes a pointer to them.
+ */
+int sys_mmap(unsigned long *buffer)
+{
+	unsigned long args[6];
+	struct file *file = NULL;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		args[i] = get_fs_long(buffer + i);
+	if (!(args[3] & MAP_ANONYMOUS)) {
+		if (args[4] >= NR_OPEN || !(file = current->filp[args[4]]))
+			return -EBADF;
+	}
+	return do_mmap(file, args[0], args[1], args[2], args[3], args[5]);
+}
+
+int sys_munmap(unsigned long addr, unsigned long len)
+{
+	if (current->flags & PF_VFORK)
+		return -EINVAL;
+	return do_munmap(addr, len);
+}
+
+/*
+ * Drop the vm areas of a child that didn't make it through fork().
+ */
+void free_mmap(struct task_struct *p)
+{
+	struct vm_area_struct *vma;
+
+	while ((vma = p->mmap) != NULL) {
+		p->mmap = vma->vm_next;
+		free_vma(vma);
+	}
+}
+
+/*
+ * Give a forked child copies of our vm areas. The pages themselves are
+ * shared copy-on-write with the page tables.
+ */
+int dup_mmap(struct task_struct *p)
+{
+	struct vm_area_struct *vma, *new, **tail;
+
+	p->mmap = NULL;
+	tail = &p->mmap;
+	for (vma = current->mmap; vma; vma = vma->vm_next) {
+		if (!(new = malloc(sizeof(struct vm_area_struct)))) {
+			free_mmap(p);
+			return -ENOMEM;
+		}
+		*new = *vma;
+		new->vm_next = NULL;
+		if (new->vm_inode)
+			new->vm_inode->i_count++;
+		*tail = new;
+		tail = &new->vm_next;
+	}
+	return 0;
+}
+
+/*
+ * Drop all mappings of the current task at exit or exec, writing back
+ * shared ones. The page tables are freed by the caller.
+ */
+void exit_mmap(void)
+{
+	struct vm_area_struct *vma;
+
+	while ((vma = current->mmap) != NULL) {
+		current->mmap = vma->vm_next;
+		if (vma->vm_inode && (vma->vm_flags & MAP_SHARED))
+			write_back(vma, vma->vm_start, vma->vm_end);
+		free_vma(vma);
+	}
+}
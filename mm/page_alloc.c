@@ -0,0 +1,333 @@
+/*
+ *  linux/mm/page_alloc.c
+ */
+
+/*
+ * The buddy page allocator. Free memory is kept in NR_MEM_LISTS lists,
+ * list 'n' holding naturally aligned blocks of 2^n pages. Each order
+ * also has a bitmap with one bit per buddy pair: the bit is set when
+ * exactly one of the two buddies is free, so that free_pages() can tell
+ * in one bit-flip whether it may coalesce with its buddy.
+ *
+ * The free blocks themselves hold the list links (all of physical
+ * memory is identity-mapped for the kernel), so the allocator needs no
+ * memory of its own except the bitmaps, which are sized at boot.
+ *
+ * mem_map[].count is the reference count: pages handed out get a count
+ * of 1, and a page only goes back on the free lists when its count
+ * drops to zero. Reserved (kernel) pages are never freed.
+ *
+ * Clearing a page costs as much as a small system call, so the idle task
+ * clears free pages ahead of time into a small pool of zeroed pages that
+ * get_free_page() prefers. Pool pages count as allocated.
+ */
+
+#include <asm/system.h>
+
+#include <linux/sched.h>
+#include <linux/head.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+
+struct mem_list {
+	struct mem_list *next;
+	struct mem_list *prev;
+};
+
+static struct mem_list free_area_list[NR_MEM_LISTS];
+static unsigned char *free_area_map[NR_MEM_LISTS];
+static int nr_free_pages = 0;
+
+/*
+ * The zero pool is a stack of cleared pages, linked through their first
+ * long, which is cleared again when the page is handed out. We stop
+ * filling it when free memory gets low, and drain it when a bigger block
+ * can't be found.
+ */
+#define ZERO_POOL_MAX		64
+#define ZERO_POOL_MIN_FREE	32
+
+static unsigned long zero_pool = 0;
+static int zero_pool_count = 0;
+static unsigned long zero_pool_hits = 0, zero_pool_misses = 0;
+
+#define PAGE_ADDR(nr) ((struct mem_list *) (LOW_MEM + ((nr) << 12)))
+
+static inline int change_bit(unsigned char *addr, unsigned int nr)
+{
+	int __res;
+
+	__asm__ __volatile__("btcl %1,%2; adcl $0,%0"
+			     :"=g"(__res)
+			     :"r"(nr), "m"(*(addr)), "0"(0)
+			     :"memory");
+	return __res;
+}
+
+static inline void add_mem_queue(struct mem_list *head, struct mem_list *entry)
+{
+	entry->prev = head;
+	entry->next = head->next;
+	head->next->prev = entry;
+	head->next = entry;
+}
+
+static inline void remove_mem_queue(struct mem_list *entry)
+{
+	entry->next->prev = entry->prev;
+	entry->prev->next = entry->next;
+}
+
+/*
+ * Put the 2^order block starting at page 'map_nr' back on the free
+ * lists, merging it with its buddy for as long as the buddy is free.
+ * Must be called with interrupts off.
+ */
+static void free_pages_ok(unsigned long map_nr, int order)
+{
+	while (order < NR_MEM_LISTS - 1) {
+		if (!change_bit(free_area_map[order], map_nr >> (1 + order)))
+			break;
+		remove_mem_queue(PAGE_ADDR(map_nr ^ (1 << order)));
+		map_nr &= ~(1 << order);
+		order++;
+	}
+	add_mem_queue(free_area_list + order, PAGE_ADDR(map_nr));
+}
+
+#define clear_pages(addr,order) ({ \
+int d0, d1; \
+__asm__ __volatile__("cld ; rep ; stosl" \
+	:"=&c" (d0), "=&D" (d1) \
+	:"a" (0), "0" (1024 << (order)), "1" (addr) \
+	:"memory"); })
+
+/*
+ * Free a block of 2^order pages at physical address 'addr'. For order
+ * 0 this just drops a reference: the page is only really freed when
+ * nobody else shares it.
+ */
+void free_pages(unsigned long addr, int order)
+{
+	unsigned long map_nr, flags;
+	int i;
+
+	if (addr < LOW_MEM)
+		return;
+	if (addr >= HIGH_MEMORY)
+		panic("trying to free nonexistent page");
+	if (addr & ((PAGE_SIZE << order) - 1))
+		panic("free_pages: unaligned block");
+	map_nr = MAP_NR(addr);
+	if (mem_map[map_nr].flags & PG_reserved)
+		return;
+	save_flags(flags);
+	cli();
+	if (!mem_map[map_nr].count)
+		panic("trying to free free page");
+	if (--mem_map[map_nr].count) {
+		restore_flags(flags);
+		return;
+	}
+	for (i = 1; i < (1 << order); i++)
+		mem_map[map_nr + i].count = 0;
+	free_pages_ok(map_nr, order);
+	nr_free_pages += 1 << order;
+	restore_flags(flags);
+}
+
+/*
+ * Free a page of memory at physical address 'addr'. Used by
+ * 'free_page_tables()'
+ */
+void free_page(unsigned long addr)
+{
+	free_pages(addr, 0);
+}
+
+/*
+ * Take a block of 2^order pages off the free lists, splitting a bigger
+ * block if need be. The memory is not cleared, and we never try to
+ * swap: this is safe to call with interrupts off. Returns 0 if no
+ * block of that size is free.
+ */
+unsigned long __get_free_pages(int order)
+{
+	struct mem_list *queue, *next;
+	unsigned long map_nr, flags;
+	int new_order, i;
+
+	if (order < 0 || order >= NR_MEM_LISTS)
+		return 0;
+	save_flags(flags);
+	cli();
+	queue = free_area_list + order;
+	for (new_order = order; new_order < NR_MEM_LISTS;
+	     new_order++, queue++) {
+		next = queue->next;
+		if (next == queue)
+			continue;
+		remove_mem_queue(next);
+		map_nr = MAP_NR((unsigned long)next);
+		if (new_order < NR_MEM_LISTS - 1)
+			change_bit(free_area_map[new_order],
+				   map_nr >> (1 + new_order));
+		while (new_order > order) {
+			new_order--;
+			add_mem_queue(free_area_list + new_order,
+				      PAGE_ADDR(map_nr + (1 << new_order)));
+			change_bit(free_area_map[new_order],
+				   map_nr >> (1 + new_order));
+		}
+		for (i = 0; i < (1 << order); i++)
+			mem_map[map_nr + i].count = 1;
+		nr_free_pages -= 1 << order;
+		restore_flags(flags);
+		return (unsigned long)next;
+	}
+	restore_flags(flags);
+	return 0;
+}
+
+static unsigned long get_zero_pool_page(void)
+{
+	unsigned long page, flags;
+
+	save_flags(flags);
+	cli();
+	if ((page = zero_pool) != 0) {
+		zero_pool = *(unsigned long *)page;
+		zero_pool_count--;
+	}
+	restore_flags(flags);
+	if (page)
+		*(unsigned long *)page = 0;
+	return page;
+}
+
+/*
+ * Give the pages of the zero pool back to the free lists, so that they
+ * can merge into bigger blocks again.
+ */
+static int drain_zero_pool(void)
+{
+	unsigned long page;
+	int nr = 0;
+
+	while ((page = get_zero_pool_page()) != 0) {
+		free_page(page);
+		nr++;
+	}
+	return nr;
+}
+
+/*
+ * Called by the idle task: clear one free page and put it in the pool.
+ * Returns 0 if there was nothing to do.
+ */
+int refill_zero_pool(void)
+{
+	unsigned long page, flags;
+
+	if (zero_pool_count >= ZERO_POOL_MAX ||
+	    nr_free_pages <= ZERO_POOL_MIN_FREE)
+		return 0;
+	if (!(page = __get_free_pages(0)))
+		return 0;
+	clear_pages(page, 0);
+	save_flags(flags);
+	cli();
+	*(unsigned long *)page = zero_pool;
+	zero_pool = page;
+	zero_pool_count++;
+	restore_flags(flags);
+	return 1;
+}
+
+/*
+ * Get a cleared block of 2^order physically contiguous pages. If memory
+ * is short we swap pages out and try again. A single page will turn up
+ * sooner or later, but there is no telling when a whole block will,
+ * so for order > 0 we only try a limited number of times.
+ */
+unsigned long get_free_pages(int order)
+{
+	unsigned long page;
+	int tries = 8 << order;
+
+	if (!order) {
+		if ((page = get_zero_pool_page()) != 0) {
+			zero_pool_hits++;
+			return page;
+		}
+		zero_pool_misses++;
+	}
+repeat:
+	if ((page = __get_free_pages(order)) != 0) {
+		clear_pages(page, order);
+		return page;
+	}
+	if (order && drain_zero_pool())
+		goto repeat;
+	if ((!order || --tries > 0) && (shrink_page_cache() || swap_out()))
+		goto repeat;
+	return 0;
+}
+
+/*
+ * Get physical address of a free page, cleared, and mark it used.
+ * If no free pages left, return 0.
+ */
+unsigned long get_free_page(void)
+{
+	return get_free_pages(0);
+}
+
+/*
+ * Hand the pages between start_mem and end_mem to the allocator. The
+ * bitmaps are taken from start_mem first (rounded to longs, as btcl
+ * accesses longs), then pages are freed one by one and merge into big
+ * blocks as they go.
+ */
+void free_area_init(unsigned long start_mem, unsigned long end_mem)
+{
+	int i, size;
+
+	for (i = 0; i < NR_MEM_LISTS; i++) {
+		free_area_list[i].next = free_area_list[i].prev =
+		    free_area_list + i;
+		size = (((paging_pages >> (i + 1)) + 32) >> 5) << 2;
+		free_area_map[i] = (unsigned char *)start_mem;
+		while (size-- > 0)
+			*(unsigned char *)(start_mem++) = 0;
+	}
+	start_mem = PAGE_ALIGN(start_mem);
+	for (; start_mem < end_mem; start_mem += PAGE_SIZE) {
+		mem_map[MAP_NR(start_mem)].count = 1;
+		mem_map[MAP_NR(start_mem)].flags = 0;
+		free_page(start_mem);
+	}
+}
+
+void show_free_areas(void)
+{
+	struct mem_list *p;
+	unsigned long flags;
+	int order, nr, total = 0;
+
+	printk("Free blocks:");
+	for (order = 0; order < NR_MEM_LISTS; order++) {
+		nr = 0;
+		save_flags(flags);
+		cli();
+		for (p = free_area_list[order].next;
+		     p != free_area_list + order; p = p->next)
+			nr++;
+		restore_flags(flags);
+		total += nr << order;
+		printk(" %d*%dkB", nr, 4 << order);
+	}
+	printk(" = %d pages\n\r", total);
+	printk("Zero pool: %d pages, %u hits, %u misses\n\r",
+	       zero_pool_count, zero_pool_hits, zero_pool_misses);
+}
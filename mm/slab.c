@@ -0,0 +1,216 @@
+/*
+ *  linux/mm/slab.c
+ */
+
+/*
+ * Object caches for kernel objects of one type (inodes, files, block
+ * requests). A cache hands out objects from slabs: single pages that
+ * start with a struct slab and hold 'num' objects after it. The free
+ * objects of a slab are chained by index in the slab header, not through
+ * the objects themselves, so a free object keeps what the constructor
+ * put in it. Users have to give objects back in that state.
+ *
+ * Slabs with free objects are on the cache's 'partial' list, full ones
+ * on 'full', and an object finds its slab by rounding its address down
+ * to the page. Empty slabs go back to the page allocator, unless that
+ * would take the cache below its reserve.
+ *
+ * Like malloc(), alloc and free can be called from interrupt level, as
+ * long as the cache doesn't have to swap to grow (SLAB_ATOMIC, or enough
+ * objects reserved).
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <asm/system.h>
+
+struct slab {
+	struct kmem_cache *cache;
+	struct slab *next;
+	struct slab *prev;
+	short free;			/* first free object, SLAB_END if full */
+	short inuse;
+};
+
+#define SLAB_END	0xff
+#define slab_bufctl(s)	((unsigned char *) ((s) + 1))
+#define slab_obj(c,s,i)	((char *) (s) + (c)->offset + (i) * (c)->size)
+
+static struct kmem_cache *cache_chain = NULL;
+
+static inline void unlink_slab(struct slab **list, struct slab *s)
+{
+	if (s->next)
+		s->next->prev = s->prev;
+	if (s->prev)
+		s->prev->next = s->next;
+	else
+		*list = s->next;
+}
+
+static inline void link_slab(struct slab **list, struct slab *s)
+{
+	s->prev = NULL;
+	if ((s->next = *list) != NULL)
+		s->next->prev = s;
+	*list = s;
+}
+
+struct kmem_cache *kmem_cache_create(const char *name, int size,
+				     void (*ctor) (void *), int flags)
+{
+	struct kmem_cache *c;
+	int num, offset;
+
+	size = (size + 3) & ~3;
+	num = (PAGE_SIZE - sizeof(struct slab)) / (size + 1);
+	if (num >= SLAB_END)
+		num = SLAB_END - 1;
+	for (; num > 0; num--) {
+		offset = (sizeof(struct slab) + num + 3) & ~3;
+		if (offset + num * size <= PAGE_SIZE)
+			break;
+	}
+	if (num <= 0)
+		panic("kmem_cache_create: object too big");
+	if (!(c = (struct kmem_cache *) malloc(sizeof(struct kmem_cache))))
+		return NULL;
+	c->name = name;
+	c->size = size;
+	c->num = num;
+	c->offset = offset;
+	c->flags = flags;
+	c->reserve = 0;
+	c->ctor = ctor;
+	c->partial = c->full = NULL;
+	c->nr_slabs = c->nr_active = c->high = 0;
+	c->nr_allocs = c->nr_frees = c->nr_grows = c->nr_reaps = 0;
+	c->next = cache_chain;
+	cache_chain = c;
+	return c;
+}
+
+/*
+ * Add a slab of constructed objects to the cache. Returns 0 if there was
+ * no page for it.
+ */
+static int kmem_cache_grow(struct kmem_cache *c)
+{
+	struct slab *s;
+	unsigned long page, flags;
+	int i;
+
+	if (c->flags & SLAB_ATOMIC)
+		page = __get_free_pages(0);
+	else
+		page = get_free_page();
+	if (!page)
+		return 0;
+	s = (struct slab *) page;
+	s->cache = c;
+	s->inuse = 0;
+	s->free = 0;
+	for (i = 0; i < c->num; i++) {
+		slab_bufctl(s)[i] = i + 1;
+		if (c->ctor)
+			c->ctor(slab_obj(c, s, i));
+	}
+	slab_bufctl(s)[c->num - 1] = SLAB_END;
+	mem_map[MAP_NR(page)].flags |= PG_slab;
+	mem_map[MAP_NR(page)].private = (unsigned long) c;
+	save_flags(flags);
+	cli();
+	link_slab(&c->partial, s);
+	c->nr_slabs++;
+	c->nr_grows++;
+	restore_flags(flags);
+	return 1;
+}
+
+/*
+ * Make sure the cache has room for 'nr' objects without growing, and
+ * keep it that way: slabs aren't given back below that. Returns 0 if
+ * there wasn't enough memory.
+ */
+int kmem_cache_reserve(struct kmem_cache *c, int nr)
+{
+	c->reserve = nr;
+	while (c->nr_slabs * c->num < nr)
+		if (!kmem_cache_grow(c))
+			return 0;
+	return 1;
+}
+
+void *kmem_cache_alloc(struct kmem_cache *c)
+{
+	struct slab *s;
+	unsigned long flags;
+	void *obj;
+
+	save_flags(flags);
+	cli();
+	while (!(s = c->partial)) {
+		restore_flags(flags);
+		if (!kmem_cache_grow(c))
+			return NULL;
+		cli();
+	}
+	obj = slab_obj(c, s, s->free);
+	s->free = slab_bufctl(s)[s->free];
+	s->inuse++;
+	if (s->free == SLAB_END) {
+		unlink_slab(&c->partial, s);
+		link_slab(&c->full, s);
+	}
+	c->nr_allocs++;
+	if (++c->nr_active > c->high)
+		c->high = c->nr_active;
+	restore_flags(flags);
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+	unsigned long page = (unsigned long) obj & 0xfffff000;
+	struct slab *s = (struct slab *) page;
+	unsigned long flags;
+	int i;
+
+	if (page < LOW_MEM || page >= HIGH_MEMORY ||
+	    !(mem_map[MAP_NR(page)].flags & PG_slab) || s->cache != c)
+		panic("kmem_cache_free: object not from this cache");
+	i = ((char *) obj - slab_obj(c, s, 0)) / c->size;
+	save_flags(flags);
+	cli();
+	if (s->free == SLAB_END) {	/* it was full */
+		unlink_slab(&c->full, s);
+		link_slab(&c->partial, s);
+	}
+	slab_bufctl(s)[i] = s->free;
+	s->free = i;
+	s->inuse--;
+	c->nr_active--;
+	c->nr_frees++;
+	if (!s->inuse && (c->nr_slabs - 1) * c->num >= c->reserve) {
+		unlink_slab(&c->partial, s);
+		c->nr_slabs--;
+		c->nr_reaps++;
+		mem_map[MAP_NR(page)].flags &= ~PG_slab;
+		mem_map[MAP_NR(page)].private = 0;
+		free_page(page);
+	}
+	restore_flags(flags);
+}
+
+void show_slab(void)
+{
+	struct kmem_cache *c;
+
+	for (c = cache_chain; c; c = c->next)
+		printk("%-8s %5d/%5d objects (high %d), %d pages, "
+		       "%d allocs, %d frees, %d grows, %d reaps\n\r",
+		       c->name, c->nr_active, c->nr_slabs * c->num, c->high,
+		       c->nr_slabs, c->nr_allocs, c->nr_frees, c->nr_grows,
+		       c->nr_reaps);
+}
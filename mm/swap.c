@@ -9,7 +9,10 @@
  * Started 18.12.91
  */
 
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <linux/mm.h>
 #include <linux/sched.h>
@@ -32,49 +35,247 @@ bitop(bit, "")
     bitop(setbit, "s")
     bitop(clrbit, "r")
 
-static char *swap_bitmap = NULL;
 int SWAP_DEV = 0;
 
+/*
+ * There can be up to MAX_SWAPFILES swap areas, each a block device with
+ * its own bitmap of free slots and swap_map[] of reference counts. A
+ * swap entry is SWP_ENTRY(type, offset): the index in swap_info[] and
+ * the page on that device.
+ *
+ * swap_map[] counts the page table entries that refer to each swap slot,
+ * so that fork() can share swapped-out pages between parent and child
+ * instead of reading them all back in. A slot goes back to the bitmap
+ * when its count drops to zero.
+ *
+ * The on-disk bitmap (the first page of the device, with "SWAP-SPACE" at
+ * the end) only covers the first SWAP_BITS pages. Bigger devices get a
+ * bigger in-memory bitmap, with everything past the first page taken as
+ * good.
+ */
+#define SWAP_MAP_MAX 0xff
+
+#define SWP_USED	1
+#define SWP_WRITEOK	3
+
+struct swap_info_struct {
+	int flags;
+	int dev;
+	int prio;		/* higher gets used first */
+	int next;		/* next area in swap_list, -1 at the end */
+	char *bitmap;		/* set bit = free slot */
+	unsigned char *map;
+	int order;		/* of the bitmap and the map */
+	int max;		/* slots are 1..max-1 */
+	int nr_free;
+	int cursor;		/* long index where the next search starts */
+	int cluster_next;
+	int cluster_left;
+};
+
+static struct swap_info_struct swap_info[MAX_SWAPFILES];
+static int nr_swapfiles = 0;
+
+/*
+ * swap_list threads the areas in use by descending priority. 'next' is
+ * where get_swap_page() looks first: it goes round-robin over the areas
+ * of the highest priority that has room, so that equal-priority devices
+ * share the paging I/O.
+ */
+static struct {
+	int head;
+	int next;
+} swap_list = { -1, -1 };
+
 /*
  * We never page the pages in task[0] - kernel memory.
- * We page all other pages.
+ * We page the user space of all other tasks.
  */
-#define FIRST_VM_PAGE (TASK_SIZE>>12)
-#define LAST_VM_PAGE (1024*1024)
-#define VM_PAGES (LAST_VM_PAGE - FIRST_VM_PAGE)
+#define FIRST_VM_DIR (TASK_SIZE>>22)
+#define LAST_VM_DIR (2*FIRST_VM_DIR)
+#define VM_PAGES (TASK_SIZE>>12)
 
-static int get_swap_page(void)
+/*
+ * Swap slots are handed out in clusters of 32 (one long of the bitmap)
+ * so that a batch of pages thrown out by swap_out() ends up next to each
+ * other on the swap device. The cursor remembers where the last cluster
+ * came from, so we don't rescan the used part of the map every time.
+ * Only when no free cluster is left do we fall back to single slots.
+ */
+#define SWAP_CLUSTER 32
+
+static inline int find_first_bit(unsigned long word)
 {
-	int nr;
+	int __res;
+
+	__asm__("bsfl %1,%0":"=r"(__res):"rm"(word));
+	return __res;
+}
 
-	if (!swap_bitmap)
+static int scan_swap_map(struct swap_info_struct *p)
+{
+	unsigned long *map = (unsigned long *)p->bitmap;
+	int i, nr, words;
+
+	if (!p->nr_free)
 		return 0;
-	for (nr = 1; nr < 32768; nr++)
-		if (clrbit(swap_bitmap, nr))
-			return nr;
+	while (p->cluster_left > 0) {
+		p->cluster_left--;
+		nr = p->cluster_next++;
+		if (nr < p->max && clrbit(p->bitmap, nr))
+			goto got;
+	}
+	words = (p->max + 31) >> 5;
+	for (i = 0; i < words; i++) {
+		nr = p->cursor + i;
+		if (nr >= words)
+			nr -= words;
+		if (map[nr] != 0xffffffff)
+			continue;
+		p->cursor = nr + 1;
+		p->cluster_next = nr * SWAP_CLUSTER + 1;
+		p->cluster_left = SWAP_CLUSTER - 1;
+		nr *= SWAP_CLUSTER;
+		clrbit(p->bitmap, nr);
+		goto got;
+	}
+	for (i = 0; i < words; i++) {
+		nr = p->cursor + i;
+		if (nr >= words)
+			nr -= words;
+		if (!map[nr])
+			continue;
+		p->cursor = nr;
+		nr = (nr << 5) + find_first_bit(map[nr]);
+		clrbit(p->bitmap, nr);
+		goto got;
+	}
+	printk("Swap-space count wrong (scan_swap_map())\n\r");
+	p->nr_free = 0;
 	return 0;
+got:
+	p->nr_free--;
+	p->map[nr] = 1;
+	return nr;
 }
 
+static int get_swap_page(void)
+{
+	struct swap_info_struct *p;
+	int type, offset, wrapped = 0;
+
+	if ((type = swap_list.next) < 0)
+		return 0;
+	for (;;) {
+		p = swap_info + type;
+		if ((p->flags & SWP_WRITEOK) == SWP_WRITEOK &&
+		    (offset = scan_swap_map(p)) != 0) {
+			type = p->next;
+			if (type < 0 || swap_info[type].prio != p->prio)
+				swap_list.next = swap_list.head;
+			else
+				swap_list.next = type;
+			return SWP_ENTRY(p - swap_info, offset);
+		}
+		type = p->next;
+		if (!wrapped) {
+			if (type < 0 || swap_info[type].prio != p->prio) {
+				type = swap_list.head;
+				wrapped = 1;
+			}
+		} else if (type < 0)
+			return 0;
+	}
+}
+
+static struct swap_info_struct *swap_info_get(int entry)
+{
+	struct swap_info_struct *p;
+	int offset = SWP_OFFSET(entry);
+
+	if (SWP_TYPE(entry) >= nr_swapfiles)
+		return NULL;
+	p = swap_info + SWP_TYPE(entry);
+	if (!(p->flags & SWP_USED) || offset <= 0 || offset >= p->max ||
+	    !p->map[offset])
+		return NULL;
+	return p;
+}
+
+void rw_swap_page(int rw, int entry, char *buffer)
+{
+	struct swap_info_struct *p = swap_info + SWP_TYPE(entry);
+
+	if (SWP_TYPE(entry) >= nr_swapfiles || !(p->flags & SWP_USED)) {
+		printk("Trying to swap to unused swap-device\n\r");
+		return;
+	}
+	ll_rw_page(rw, p->dev, SWP_OFFSET(entry), buffer);
+}
+
+/*
+ * Drop one reference to a swap slot, freeing it if it was the last.
+ */
 void swap_free(int swap_nr)
 {
+	struct swap_info_struct *p;
+	int offset = SWP_OFFSET(swap_nr);
+
 	if (!swap_nr)
 		return;
-	if (swap_bitmap && swap_nr < SWAP_BITS)
-		if (!setbit(swap_bitmap, swap_nr))
+	if (swap_nr & SWP_ZSWAP) {
+		zswap_free(swap_nr);
+		return;
+	}
+	if ((p = swap_info_get(swap_nr)) != NULL) {
+		if (--p->map[offset])
+			return;
+		if (!setbit(p->bitmap, offset)) {
+			p->nr_free++;
 			return;
+		}
+	}
 	printk("Swap-space bad (swap_free())\n\r");
 	return;
 }
 
+/*
+ * Add a reference to a swap slot for a new page table entry. Returns 0
+ * if the count would overflow, in which case the caller has to read the
+ * page in and give the copy its own slot.
+ */
+int swap_duplicate(int swap_nr)
+{
+	struct swap_info_struct *p;
+
+	if (swap_nr & SWP_ZSWAP)
+		return zswap_duplicate(swap_nr);
+	if (!(p = swap_info_get(swap_nr))) {
+		printk("Swap-space bad (swap_duplicate())\n\r");
+		return 0;
+	}
+	if (p->map[SWP_OFFSET(swap_nr)] >= SWAP_MAP_MAX)
+		return 0;
+	p->map[SWP_OFFSET(swap_nr)]++;
+	return 1;
+}
+
+/*
+ * Read the page in swap entry 'swap_nr', wherever it is.
+ */
+void read_swap_entry(int swap_nr, char *buffer)
+{
+	if (swap_nr & SWP_ZSWAP)
+		zswap_load(swap_nr, buffer);
+	else
+		read_swap_page(swap_nr, buffer);
+}
+
 void swap_in(unsigned long *table_ptr)
 {
 	int swap_nr;
 	unsigned long page;
 
-	if (!swap_bitmap) {
-		printk("Trying to swap in without swap bit-map");
-		return;
-	}
 	if (1 & *table_ptr) {
 		printk("trying to swap in present page\n\r");
 		return;
@@ -86,13 +287,23 @@ void swap_in(unsigned long *table_ptr)
 	}
 	if (!(page = get_free_page()))
 		oom();
-	read_swap_page(swap_nr, (char *)page);
-	if (setbit(swap_bitmap, swap_nr))
-		printk("swapping in multiply from same page\n\r");
+	read_swap_entry(swap_nr, (char *)page);
+	if (*table_ptr != swap_nr << 1) {
+		free_page(page);
+		return;
+	}
+	swap_free(swap_nr);
 	*table_ptr = page | (PAGE_DIRTY | 7);
 }
 
-int try_to_swap_out(unsigned long *table_ptr)
+/*
+ * try_to_swap_out() is the second-chance test of the page clock: a page
+ * that has been touched since we last looked gets its accessed bit
+ * cleared and is left alone. Dirty pages have to be written to swap,
+ * so we only take them when 'dirty_ok' says we have to.
+ */
+int try_to_swap_out(unsigned long *table_ptr, int dirty_ok,
+		    struct task_struct *p, unsigned long address)
 {
 	unsigned long page;
 	unsigned long swap_nr;
@@ -100,147 +311,434 @@ int try_to_swap_out(unsigned long *table_ptr)
 	page = *table_ptr;
 	if (!(PAGE_PRESENT & page))
 		return 0;
-	if (page - LOW_MEM > PAGING_MEMORY)
+	if (page < LOW_MEM || page >= HIGH_MEMORY)
+		return 0;
+	if (PAGE_ACCESSED & page) {
+		*table_ptr = page & ~PAGE_ACCESSED;
+/* else a cached TLB entry keeps the cpu from setting it again */
+		flush_task_page(table_ptr, p, address);
 		return 0;
+	}
+	if (mem_map[MAP_NR(page)].inode) {	/* page cache: no swap */
+		if (PAGE_DIRTY & page)
+			mem_map[MAP_NR(page)].flags |= PG_dirty;
+		*table_ptr = 0;
+		flush_task_page(table_ptr, p, address);
+		free_page(page & 0xfffff000);
+		return 1;
+	}
 	if (PAGE_DIRTY & page) {
+		if (!dirty_ok)
+			return 0;
 		page &= 0xfffff000;
-		if (mem_map[MAP_NR(page)] != 1)
+		if (mem_map[MAP_NR(page)].count != 1)
 			return 0;
-		if (!(swap_nr = get_swap_page()))
+		if (!(swap_nr = zswap_store(page)) &&
+		    !(swap_nr = get_swap_page()))
 			return 0;
 		*table_ptr = swap_nr << 1;
-		invalidate();
-		write_swap_page(swap_nr, (char *)page);
+		flush_task_page(table_ptr, p, address);
+		if (!(swap_nr & SWP_ZSWAP))
+			write_swap_page(swap_nr, (char *)page);
 		free_page(page);
 		return 1;
 	}
 	*table_ptr = 0;
-	invalidate();
-	free_page(page);
+	flush_task_page(table_ptr, p, address);
+	free_page(page & 0xfffff000);
 	return 1;
 }
 
 /*
- * Ok, this has a rather intricate logic - the idea is to make good
- * and fast machine code. If we didn't worry about that, things would
- * be easier.
+ * The recent fault rate of a task: page faults, halved every second.
+ * It decays lazily, when somebody looks at it.
  */
-int swap_out(void)
+static unsigned long fault_rate(struct task_struct *p)
 {
-	static int dir_entry = FIRST_VM_PAGE >> 10;
-	static int page_entry = -1;
-	int counter = VM_PAGES;
-	int pg_table = 0, d_entry;
+	unsigned long n = (jiffies - p->flt_stamp) / HZ;
 
-	while (counter > 0) {
-		pg_table = pg_dir[dir_entry];
-		if (pg_table & 1)
-			break;
-		counter -= 1024;
-		dir_entry++;
-		if (dir_entry >= 1024)
-			dir_entry = FIRST_VM_PAGE >> 10;
-	}
-	d_entry = dir_entry;
-	pg_table &= 0xfffff000;
-	while (counter-- > 0) {
-		page_entry++;
-		if (page_entry >= 1024) {
-			page_entry = 0;
-repeat:
-			dir_entry++;
-			if (dir_entry >= 1024)
-				dir_entry = FIRST_VM_PAGE >> 10;
-			pg_table = pg_dir[dir_entry];
-			if (!(pg_table & 1))
-				if ((counter -= 1024) > 0)
-					goto repeat;
-				else
-					break;
+	if (n) {
+		p->flt_rate = (n < 32) ? p->flt_rate >> n : 0;
+		p->flt_stamp += n * HZ;
+	}
+	return p->flt_rate;
+}
+
+void count_fault(struct task_struct *p)
+{
+	fault_rate(p);
+	p->flt_rate++;
+}
+
+/*
+ * Run the CLOCK over the user space of task 'p', starting where it
+ * stopped last time (p->swap_address). Accessed bits are cleared as
+ * the hand goes by, so only pages that haven't been used for a full
+ * turn are evicted. Returns 1 if a page was freed.
+ */
+int swap_out_task(struct task_struct *p, int dirty_ok)
+{
+	unsigned long address = p->swap_address, pg_table;
+	int counter, n;
+
+	if (address < TASK_SIZE || address >= 2UL * TASK_SIZE)
+		address = TASK_SIZE;
+	for (counter = VM_PAGES; counter > 0; counter -= n) {
+		pg_table = *((unsigned long *)p->tss.cr3 + (address >> 22));
+		if (!(pg_table & 1))
+			n = (0x400000 - (address & 0x3fffff)) >> 12;
+		else {
+			n = 1;
 			pg_table &= 0xfffff000;
+			if (try_to_swap_out((unsigned long *)pg_table +
+					    ((address >> 12) & 0x3ff),
+					    dirty_ok, p, address)) {
+				p->swap_address = address + PAGE_SIZE;
+				if (p->rss)
+					--p->rss;
+				return 1;
+			}
 		}
-		if (try_to_swap_out(page_entry + (unsigned long *)pg_table)) {
-			--task[d_entry >> 4]->rss;
-			return 1;
-		}
+		address += n << 12;
+		if (address >= 2UL * TASK_SIZE)
+			address = TASK_SIZE;
 	}
-	printk("Out of swap-memory\n\r");
+	p->swap_address = address;
 	return 0;
 }
 
 /*
- * Get physical address of first (actually last :-) free page, and mark it
- * used. If no free pages left, return 0.
+ * How much we'd like to take pages from 'p': its resident set, weighted
+ * by how fast it has been faulting pages in recently, so that memory
+ * pressure falls on the tasks that cause it rather than on small ones
+ * that just woke up. Tasks over their RLIMIT_RSS go first.
  */
-unsigned long get_free_page(void)
+static unsigned long swap_badness(struct task_struct *p)
 {
-	register unsigned long __res asm("ax");
+	unsigned long rate = fault_rate(p), score;
 
-repeat:
-__asm__("std ; repne ; scasb\n\t" "jne 1f\n\t" "movb $1,1(%%edi)\n\t" "sall $12,%%ecx\n\t" "addl %2,%%ecx\n\t" "movl %%ecx,%%edx\n\t" "movl $1024,%%ecx\n\t" "leal 4092(%%edx),%%edi\n\t" "rep ; stosl\n\t" "movl %%edx,%%eax\n" "1:":"=a"(__res)
-:		"0"(0), "i"(LOW_MEM), "c"(PAGING_PAGES),
-		"D"(mem_map + PAGING_PAGES - 1)
-:	    );
-	if (__res >= HIGH_MEMORY)
-		goto repeat;
-	if (!__res && swap_out())
-		goto repeat;
-	return __res;
+	if (rate > 1023)
+		rate = 1023;
+	score = p->rss * (rate + 1);
+	if (p->rss > (p->rlim[RLIMIT_RSS].rlim_cur >> 12))
+		score |= 0x40000000;
+	return score;
 }
 
-void init_swapping(void)
+/*
+ * swap_out() picks the worst task (see swap_badness()) that it hasn't
+ * tried yet, and runs its CLOCK. A vfork()ed child is skipped, as it
+ * only borrows its parent's page directory. We make up to three rounds,
+ * getting less choosy each time:
+ *
+ *	SWAP_COLD	clean pages of tasks that aren't running
+ *	SWAP_CLEAN	clean pages of any task
+ *	SWAP_DIRTY	anything, compressing dirty pages into the zswap
+ *			pool or writing them to the swap device
+ *
+ * Clean pages cost nothing to drop (they come back from the executable
+ * or as zero pages), so we only write to swap when we have to.
+ */
+#define SWAP_COLD	0
+#define SWAP_CLEAN	1
+#define SWAP_DIRTY	2
+
+static struct task_struct *pick_victim(int pass, unsigned long *tried)
+{
+	struct task_struct *p, *best = NULL;
+	unsigned long score, best_score = 0;
+	int nr, best_nr = 0;
+
+	for (nr = 1; nr < NR_TASKS; nr++) {
+		if (!(p = task[nr]) || !p->rss || (p->flags & PF_VFORK))
+			continue;
+		if (tried[nr >> 5] & (1 << (nr & 31)))
+			continue;
+		if (pass == SWAP_COLD && p->state == TASK_RUNNING)
+			continue;
+		if ((score = swap_badness(p)) > best_score) {
+			best = p;
+			best_nr = nr;
+			best_score = score;
+		}
+	}
+	if (best)
+		tried[best_nr >> 5] |= 1 << (best_nr & 31);
+	return best;
+}
+
+int swap_out(void)
+{
+	unsigned long tried[(NR_TASKS + 31) / 32];
+	struct task_struct *p;
+	int pass, i;
+
+	for (pass = SWAP_COLD; pass <= SWAP_DIRTY; pass++) {
+		for (i = 0; i < (NR_TASKS + 31) / 32; i++)
+			tried[i] = 0;
+		while ((p = pick_victim(pass, tried)) != NULL)
+			if (swap_out_task(p, pass == SWAP_DIRTY))
+				return 1;
+	}
+	invalidate();
+	printk("Out of swap-memory\n\r");
+	return 0;
+}
+
+/*
+ * Set up 'dev' as a swap area of priority 'prio'. We may sleep reading
+ * the header, so the swap_info slot is marked used (but not writable)
+ * until we are done.
+ */
+static int setup_swap_area(int dev, int prio)
 {
 	extern int *blk_size[];
-	int swap_size, i, j;
+	struct swap_info_struct *p;
+	int type, swap_size, order, i, j, *prev;
 
-	if (!SWAP_DEV)
-		return;
-	if (!blk_size[MAJOR(SWAP_DEV)]) {
+	for (type = 0; type < MAX_SWAPFILES; type++)
+		if ((swap_info[type].flags & SWP_USED) &&
+		    swap_info[type].dev == dev)
+			return -EBUSY;
+	for (type = 0, p = swap_info; type < MAX_SWAPFILES; type++, p++)
+		if (!(p->flags & SWP_USED))
+			break;
+	if (type >= MAX_SWAPFILES)
+		return -EPERM;
+	if (!blk_size[MAJOR(dev)]) {
 		printk("Unable to get size of swap device\n\r");
-		return;
+		return -ENXIO;
 	}
-	swap_size = blk_size[MAJOR(SWAP_DEV)][MINOR(SWAP_DEV)];
-	if (!swap_size)
-		return;
+	swap_size = blk_size[MAJOR(dev)][MINOR(dev)];
 	if (swap_size < 100) {
 		printk("Swap device too small (%d blocks)\n\r", swap_size);
-		return;
+		return -EINVAL;
 	}
 	swap_size >>= 2;
-	if (swap_size > SWAP_BITS)
-		swap_size = SWAP_BITS;
-	swap_bitmap = (char *)get_free_page();
-	if (!swap_bitmap) {
+	if (swap_size > (PAGE_SIZE << (NR_MEM_LISTS - 1)))
+		swap_size = PAGE_SIZE << (NR_MEM_LISTS - 1);
+	for (order = 0; (PAGE_SIZE << order) < swap_size; order++)
+		/* nothing */ ;
+	memset(p, 0, sizeof(*p));
+	p->flags = SWP_USED;
+	p->dev = dev;
+	p->prio = prio;
+	p->order = order;
+	if (type >= nr_swapfiles)
+		nr_swapfiles = type + 1;
+/* the bitmap needs an eighth of the map, but at least a page */
+	p->bitmap = (char *)get_free_pages(order > 3 ? order - 3 : 0);
+	p->map = (unsigned char *)get_free_pages(order);
+	if (!p->bitmap || !p->map) {
 		printk("Unable to start swapping: out of memory :-)\n\r");
-		return;
+		goto bad;
 	}
-	read_swap_page(0, swap_bitmap);
-	if (strncmp("SWAP-SPACE", swap_bitmap + 4086, 10)) {
+	memset(p->bitmap, 0, PAGE_SIZE << (order > 3 ? order - 3 : 0));
+	memset(p->map, 0, PAGE_SIZE << order);
+	ll_rw_page(READ, dev, 0, p->bitmap);
+	if (strncmp("SWAP-SPACE", p->bitmap + 4086, 10)) {
 		printk("Unable to find swap-space signature\n\r");
-		free_page((long)swap_bitmap);
-		swap_bitmap = NULL;
-		return;
+		goto bad;
 	}
-	memset(swap_bitmap + 4086, 0, 10);
+	memset(p->bitmap + 4086, 0, 10);
 	for (i = 0; i < SWAP_BITS; i++) {
 		if (i == 1)
 			i = swap_size;
-		if (bit(swap_bitmap, i)) {
+		if (bit(p->bitmap, i)) {
 			printk("Bad swap-space bit-map\n\r");
-			free_page((long)swap_bitmap);
-			swap_bitmap = NULL;
-			return;
+			goto bad;
 		}
 	}
+	for (i = SWAP_BITS; i < swap_size; i++)
+		setbit(p->bitmap, i);
 	j = 0;
 	for (i = 1; i < swap_size; i++)
-		if (bit(swap_bitmap, i))
+		if (bit(p->bitmap, i))
 			j++;
-	if (!j) {
-		free_page((long)swap_bitmap);
-		swap_bitmap = NULL;
+	if (!j)
+		goto bad;
+	p->max = swap_size;
+	p->nr_free = j;
+	for (prev = &swap_list.head; *prev >= 0; prev = &swap_info[*prev].next)
+		if (swap_info[*prev].prio < prio)
+			break;
+	p->next = *prev;
+	*prev = type;
+	swap_list.next = swap_list.head;
+	p->flags = SWP_WRITEOK;
+	printk("Adding swap: %d pages (%d bytes) swap-space, priority %d\n\r",
+	       j, j * 4096, prio);
+	return 0;
+bad:
+	free_pages((unsigned long)p->bitmap, order > 3 ? order - 3 : 0);
+	free_pages((unsigned long)p->map, order);
+	p->flags = 0;
+	return -EINVAL;
+}
+
+/*
+ * Find a page table entry that refers to area 'type', or 0 if none is
+ * left.
+ */
+static int find_swap_entry(int type)
+{
+	unsigned long *dir, *pte, entry;
+	int nr, i, j;
+
+	for (nr = 1; nr < NR_TASKS; nr++) {
+		if (!task[nr])
+			continue;
+		dir = (unsigned long *)task[nr]->tss.cr3;
+		for (i = FIRST_VM_DIR; i < LAST_VM_DIR; i++) {
+			if (!(1 & dir[i]))
+				continue;
+			pte = (unsigned long *)(0xfffff000 & dir[i]);
+			for (j = 0; j < 1024; j++, pte++) {
+				entry = *pte >> 1;
+				if (!entry || (1 & *pte) || (entry & SWP_ZSWAP))
+					continue;
+				if (SWP_TYPE(entry) == type)
+					return entry;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Put 'page', which holds swap 'entry', into every page table entry that
+ * still refers to the slot, and drop the slot. Page tables shared after
+ * fork() (and a vfork()ed child's directory) turn up under more than one
+ * task, but once an entry is replaced it no longer matches, so each one
+ * is done once. swap_map[] says how many there are: if there are more
+ * than one, they share the page copy-on-write.
+ */
+static void unuse_swap_entry(int entry, unsigned long page)
+{
+	struct swap_info_struct *p;
+	unsigned long *dir, *pte, prot;
+	int nr, i, j;
+
+	if (!(p = swap_info_get(entry)))
 		return;
+	prot = (p->map[SWP_OFFSET(entry)] > 1) ? 5 : 7;
+	for (nr = 1; nr < NR_TASKS; nr++) {
+		if (!task[nr])
+			continue;
+		dir = (unsigned long *)task[nr]->tss.cr3;
+		for (i = FIRST_VM_DIR; i < LAST_VM_DIR; i++) {
+			if (!(1 & dir[i]))
+				continue;
+			pte = (unsigned long *)(0xfffff000 & dir[i]);
+			for (j = 0; j < 1024; j++, pte++) {
+				if (*pte != entry << 1)
+					continue;
+				if (!get_page_ref(page))
+					return;	/* the next page gets the rest */
+				*pte = page | PAGE_DIRTY | prot;
+				swap_free(entry);
+				task[nr]->rss++;
+			}
+		}
+	}
+}
+
+/*
+ * Bring everything on area 'type' back into memory. Getting a page and
+ * reading the slot in both sleep, and the tasks may fault the slot in or
+ * fork meanwhile: so the page tables are only looked at once the page
+ * is in, by unuse_swap_entry(), which doesn't sleep.
+ */
+static int try_to_unuse(int type)
+{
+	unsigned long page;
+	int entry;
+
+	while ((entry = find_swap_entry(type)) != 0) {
+		if (!(page = get_free_page()))
+			return -ENOMEM;
+		read_swap_page(entry, (char *)page);
+		unuse_swap_entry(entry, page);
+		free_page(page);
+		invalidate();
+	}
+	return 0;
+}
+
+static int get_swap_dev(const char *specialfile)
+{
+	struct m_inode *inode;
+	int dev;
+
+	if (!(inode = namei(specialfile)))
+		return -ENOENT;
+	dev = inode->i_zone[0];
+	if (!S_ISBLK(inode->i_mode)) {
+		iput(inode);
+		return -ENOTBLK;
+	}
+	iput(inode);
+	return dev;
+}
+
+static int least_priority = 0;
+
+int sys_swapon(const char *specialfile, int swap_flags)
+{
+	int dev, prio;
+
+	if (!suser())
+		return -EPERM;
+	if ((dev = get_swap_dev(specialfile)) < 0)
+		return dev;
+	if (swap_flags & SWAP_FLAG_PREFER)
+		prio = swap_flags & SWAP_FLAG_PRIO_MASK;
+	else
+		prio = --least_priority;
+	return setup_swap_area(dev, prio);
+}
+
+int sys_swapoff(const char *specialfile)
+{
+	struct swap_info_struct *p;
+	int dev, type, *prev, error;
+
+	if (!suser())
+		return -EPERM;
+	if ((dev = get_swap_dev(specialfile)) < 0)
+		return dev;
+	for (prev = &swap_list.head; (type = *prev) >= 0;
+	     prev = &swap_info[type].next)
+		if (swap_info[type].dev == dev)
+			break;
+	if (type < 0)
+		return -EINVAL;
+	p = swap_info + type;
+	*prev = p->next;
+	swap_list.next = swap_list.head;
+	p->flags = SWP_USED;
+	if ((error = try_to_unuse(type)) != 0) {
+		for (prev = &swap_list.head; *prev >= 0;
+		     prev = &swap_info[*prev].next)
+			if (swap_info[*prev].prio < p->prio)
+				break;
+		p->next = *prev;
+		*prev = type;
+		swap_list.next = swap_list.head;
+		p->flags = SWP_WRITEOK;
+		return error;
 	}
-	printk("Swap device ok: %d pages (%d bytes) swap-space\n\r", j,
-	       j * 4096);
+	free_pages((unsigned long)p->bitmap, p->order > 3 ? p->order - 3 : 0);
+	free_pages((unsigned long)p->map, p->order);
+	p->flags = 0;
+	return 0;
+}
+
+/*
+ * The swap device from the boot sector becomes the first swap area.
+ */
+void init_swapping(void)
+{
+	if (SWAP_DEV)
+		setup_swap_area(SWAP_DEV, --least_priority);
 }
@@ -0,0 +1,240 @@
+/*
+ *  linux/mm/zswap.c
+ */
+
+/*
+ * A compressed swap cache in front of the swap device. swap_out() first
+ * tries to compress a dirty page into the pool here, and only writes it
+ * to a swap area if it doesn't compress well enough or the pool is full.
+ * Bringing such a page back in is a decompress, not a disk read, and it
+ * works without any swap device at all.
+ *
+ * The pool is made of whole pages that hold up to two compressed pages
+ * each, one at the start of the page and one at the end ("buddies"), so
+ * objects are never more than half a page. An entry number names the
+ * pool page and the half, and has SWP_ZSWAP set to tell it from a slot
+ * on the swap device. Each entry has a reference count, like the slots
+ * in swap_map[], so that fork() can share it.
+ *
+ * The compressor is a simple LZ77 (along the lines of LZRW1): groups of
+ * eight items, each group preceded by a control byte with one bit per
+ * item. An item is either a literal byte, or a 2-byte match of 3-18
+ * bytes up to 4095 bytes back.
+ */
+
+#include <linux/mm.h>
+#include <linux/kernel.h>
+
+#define ZPOOL_PAGES	256
+#define ZSWAP_MAX_LEN	(PAGE_SIZE / 2)
+
+static unsigned long zpool[ZPOOL_PAGES];	/* 0 if not allocated */
+static unsigned short zpool_len[ZPOOL_PAGES][2];	/* 0 if that half is free */
+static unsigned char zswap_count[ZPOOL_PAGES][2];
+static int zpool_pages = 0;
+
+static int zswap_stored = 0;
+static unsigned long zswap_rejected = 0;	/* didn't compress well enough */
+static unsigned long zswap_full = 0;		/* no room in the pool */
+
+#define LZ_HASH_SIZE	1024
+#define LZ_MIN_MATCH	3
+#define LZ_MAX_MATCH	18
+
+/*
+ * The hash table isn't cleared between pages: stale positions are caught
+ * because they point at or past the current position, or because the
+ * bytes there don't match.
+ */
+static unsigned short lz_hash[LZ_HASH_SIZE];
+static unsigned char lz_buf[ZSWAP_MAX_LEN];
+
+/*
+ * Compress a page into 'dst'. Returns the compressed length, or 0 if it
+ * would take more than 'max' bytes.
+ */
+static int lz_compress(unsigned char *src, unsigned char *dst, int max)
+{
+	unsigned char *ip = src, *end = src + PAGE_SIZE, *ref;
+	unsigned char *op = dst, *ctrl = dst;
+	unsigned int h, off, len;
+	int bit = 8;
+
+	while (ip < end) {
+		if (bit == 8) {
+			if (op + 1 + 8 * 2 > dst + max)
+				return 0;
+			ctrl = op++;
+			*ctrl = 0;
+			bit = 0;
+		}
+		if (ip + LZ_MIN_MATCH <= end) {
+			h = ((ip[0] << 6) ^ (ip[1] << 3) ^ ip[2]) &
+			    (LZ_HASH_SIZE - 1);
+			ref = src + lz_hash[h];
+			lz_hash[h] = ip - src;
+			if (ref < ip && ref[0] == ip[0] && ref[1] == ip[1] &&
+			    ref[2] == ip[2]) {
+				off = ip - ref;
+				len = LZ_MIN_MATCH;
+				while (len < LZ_MAX_MATCH && ip + len < end &&
+				       ref[len] == ip[len])
+					len++;
+				*op++ = ((len - LZ_MIN_MATCH) << 4) | (off >> 8);
+				*op++ = off;
+				*ctrl |= 1 << bit++;
+				ip += len;
+				continue;
+			}
+		}
+		*op++ = *ip++;
+		bit++;
+	}
+	return op - dst;
+}
+
+static void lz_decompress(unsigned char *ip, unsigned char *dst)
+{
+	unsigned char *op = dst, *end = dst + PAGE_SIZE;
+	unsigned int ctrl = 0, off, len;
+	int bit = 8;
+
+	while (op < end) {
+		if (bit == 8) {
+			ctrl = *ip++;
+			bit = 0;
+		}
+		if (ctrl & (1 << bit++)) {
+			len = (ip[0] >> 4) + LZ_MIN_MATCH;
+			off = ((ip[0] & 0x0f) << 8) | ip[1];
+			ip += 2;
+			while (len--) {
+				*op = *(op - off);
+				op++;
+			}
+		} else
+			*op++ = *ip++;
+	}
+}
+
+static inline unsigned long zswap_addr(int pool, int half)
+{
+	if (half)
+		return zpool[pool] + PAGE_SIZE - zpool_len[pool][half];
+	return zpool[pool];
+}
+
+/*
+ * Find a free half for 'len' bytes, in a pool page we already have if
+ * possible. The pool never takes more than an eighth of memory, and we
+ * don't swap to get a page for it: if there is none, the page goes to
+ * a swap area instead.
+ */
+static int zswap_find(int len, int *half)
+{
+	int i, free = -1;
+
+	for (i = 0; i < ZPOOL_PAGES; i++) {
+		if (!zpool[i]) {
+			if (free < 0)
+				free = i;
+			continue;
+		}
+		if (zpool_len[i][0] && zpool_len[i][1])
+			continue;
+		if (zpool_len[i][0] + zpool_len[i][1] + len > PAGE_SIZE)
+			continue;
+		*half = zpool_len[i][0] ? 1 : 0;
+		return i;
+	}
+	if (free < 0 || zpool_pages >= (paging_pages >> 3))
+		return -1;
+	if (!(zpool[free] = __get_free_pages(0)))
+		return -1;
+	zpool_pages++;
+	*half = 0;
+	return free;
+}
+
+/*
+ * Compress the page at 'page' into the pool. Returns the new entry
+ * number, or 0 if it has to go to the swap device.
+ */
+int zswap_store(unsigned long page)
+{
+	int len, i, half;
+
+	if (!(len = lz_compress((unsigned char *)page, lz_buf, ZSWAP_MAX_LEN))) {
+		zswap_rejected++;
+		return 0;
+	}
+	if ((i = zswap_find(len, &half)) < 0) {
+		zswap_full++;
+		return 0;
+	}
+	zpool_len[i][half] = len;
+	zswap_count[i][half] = 1;
+	__asm__("cld ; rep ; movsb"
+		::"S" (lz_buf), "D" (zswap_addr(i, half)), "c" (len));
+	zswap_stored++;
+	return SWP_ZSWAP | (i << 1) | half;
+}
+
+#define ZSWAP_OK(nr) (((nr) & ~SWP_ZSWAP) < 2 * ZPOOL_PAGES && \
+		      zswap_count[((nr) & ~SWP_ZSWAP) >> 1][(nr) & 1])
+
+void zswap_load(int nr, char *buffer)
+{
+	if (!ZSWAP_OK(nr)) {
+		printk("zswap: bad entry %08x in zswap_load\n\r", nr);
+		return;
+	}
+	nr &= ~SWP_ZSWAP;
+	lz_decompress((unsigned char *)zswap_addr(nr >> 1, nr & 1),
+		      (unsigned char *)buffer);
+}
+
+/*
+ * Add a reference to an entry. Returns 0 if the count would overflow,
+ * see swap_duplicate().
+ */
+int zswap_duplicate(int nr)
+{
+	if (!ZSWAP_OK(nr)) {
+		printk("zswap: bad entry %08x in zswap_duplicate\n\r", nr);
+		return 0;
+	}
+	nr &= ~SWP_ZSWAP;
+	if (zswap_count[nr >> 1][nr & 1] >= 0xff)
+		return 0;
+	zswap_count[nr >> 1][nr & 1]++;
+	return 1;
+}
+
+void zswap_free(int nr)
+{
+	int i;
+
+	if (!ZSWAP_OK(nr)) {
+		printk("zswap: bad entry %08x in zswap_free\n\r", nr);
+		return;
+	}
+	nr &= ~SWP_ZSWAP;
+	i = nr >> 1;
+	if (--zswap_count[i][nr & 1])
+		return;
+	zpool_len[i][nr & 1] = 0;
+	zswap_stored--;
+	if (zpool_len[i][0] || zpool_len[i][1])
+		return;
+	free_page(zpool[i]);
+	zpool[i] = 0;
+	zpool_pages--;
+}
+
+void show_zswap(void)
+{
+	printk("%d pages in compressed swap (%d pool pages), "
+	       "%d rejected, %d pool full\n\r",
+	       zswap_stored, zpool_pages, zswap_rejected, zswap_full);
+}